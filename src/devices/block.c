@@ -3,7 +3,13 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* A block device. */
 struct block {
@@ -18,6 +24,11 @@ struct block {
 
   unsigned long long read_cnt;  /* Number of sectors read. */
   unsigned long long write_cnt; /* Number of sectors written. */
+
+  struct block_queue queue; /* Requests waiting for the driver. */
+
+  struct blkstat stats; /* Request statistics. */
+  unsigned in_flight;   /* Requests submitted but not completed. */
 };
 
 /* List of all block devices. */
@@ -90,14 +101,197 @@ static void check_sector(struct block* block, block_sector_t sector) {
   }
 }
 
+/* Verifies that the CNT sectors starting at SECTOR lie within
+   BLOCK.  Panics if not. */
+static void check_sectors(struct block* block, block_sector_t sector, size_t cnt) {
+  if (cnt > 0)
+    check_sector(block, sector);
+  if (cnt > block->size - sector)
+    check_sector(block, sector + cnt - 1);
+}
+
+/* Carries out request R on BLOCK at once with the driver's read
+   and write functions, a run of sectors at a time if the driver
+   supports it and one sector at a time otherwise. */
+static void block_transfer(struct block* block, struct block_request* r) {
+  const struct block_operations* ops = block->ops;
+  uint8_t* p = r->buffer;
+  size_t i;
+
+  if (r->write && r->cnt > 1 && ops->write_multiple != NULL)
+    ops->write_multiple(block->aux, r->sector, r->cnt, p);
+  else if (!r->write && r->cnt > 1 && ops->read_multiple != NULL)
+    ops->read_multiple(block->aux, r->sector, r->cnt, p);
+  else
+    for (i = 0; i < r->cnt; i++) {
+      if (r->write)
+        ops->write(block->aux, r->sector + i, p + i * BLOCK_SECTOR_SIZE);
+      else
+        ops->read(block->aux, r->sector + i, p + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
+/* Starts request R on BLOCK and returns, normally before the
+   transfer ends, which is signaled by calling R->done.  If
+   BLOCK's driver has a request queue, R waits in it until the
+   driver dispatches it, so a caller can keep many requests
+   outstanding, in the order chosen by the I/O scheduler.
+   Otherwise, R is carried out, and R->done called, before
+   returning.  Counts as R->cnt sector reads or writes.
+   May be called from an interrupt handler if BLOCK's driver has
+   a request queue. */
+void block_submit(struct block* block, struct block_request* r) {
+  enum intr_level old_level = intr_disable();
+  unsigned depth = block->in_flight++;
+  block->stats.depth[depth < BLKSTAT_DEPTH_CNT ? depth : BLKSTAT_DEPTH_CNT - 1]++;
+  intr_set_level(old_level);
+
+  r->block = block;
+  r->start = timer_usec();
+  block_forward(block, r);
+}
+
+/* Passes request R, submitted to a block device that is built on
+   BLOCK, such as a partition of it, on to BLOCK, to be carried
+   out as by block_submit().  R's statistics stay with the device
+   it was submitted to. */
+void block_forward(struct block* block, struct block_request* r) {
+  enum intr_level old_level;
+
+  check_sectors(block, r->sector, r->cnt);
+  ASSERT(r->cnt > 0);
+  ASSERT(is_kernel_vaddr(r->buffer));
+  ASSERT(!r->write || block->type != BLOCK_FOREIGN);
+
+  /* Counted with interrupts off, since drivers forward requests
+     from their interrupt handlers. */
+  old_level = intr_disable();
+  if (r->write)
+    block->write_cnt += r->cnt;
+  else
+    block->read_cnt += r->cnt;
+  intr_set_level(old_level);
+
+  if (block->ops->submit != NULL)
+    block->ops->submit(block->aux, r);
+  else if (block->ops->kick != NULL) {
+    old_level = intr_disable();
+    block->queue.sched->add(&block->queue, r);
+    intr_set_level(old_level);
+    block->ops->kick(block->aux);
+  } else {
+    block_transfer(block, r);
+    block_complete(r);
+  }
+}
+
+/* Returns the histogram bucket of a request that took USEC
+   microseconds. */
+static int latency_bucket(int64_t usec) {
+  int bucket = 0;
+  while (usec >= 2 && bucket < BLKSTAT_LATENCY_CNT - 1) {
+    usec /= 2;
+    bucket++;
+  }
+  return bucket;
+}
+
+/* Records that request R is done and calls R->done.  Drivers
+   call this, possibly from an interrupt handler, when they
+   finish a request. */
+void block_complete(struct block_request* r) {
+  struct block* block = r->block;
+  struct blkstat* st = &block->stats;
+  int bucket = latency_bucket(timer_usec() - r->start);
+  enum intr_level old_level = intr_disable();
+
+  if (r->write) {
+    st->write_cnt++;
+    st->write_bytes += r->cnt * BLOCK_SECTOR_SIZE;
+    st->write_latency[bucket]++;
+  } else {
+    st->read_cnt++;
+    st->read_bytes += r->cnt * BLOCK_SECTOR_SIZE;
+    st->read_latency[bucket]++;
+  }
+  block->in_flight--;
+  intr_set_level(old_level);
+
+  r->done(r);
+}
+
+/* Records that a driver spent USEC microseconds polling the
+   device's status while carrying out request R, sleeping SLEEPS
+   timer ticks of that time. */
+void block_add_poll_time(struct block_request* r, int64_t usec, unsigned sleeps) {
+  enum intr_level old_level = intr_disable();
+  r->block->stats.poll_usec += usec;
+  r->block->stats.poll_sleeps += sleeps;
+  intr_set_level(old_level);
+}
+
+/* Copies BLOCK's request statistics into *ST. */
+void block_get_stats(struct block* block, struct blkstat* st) {
+  enum intr_level old_level = intr_disable();
+  *st = block->stats;
+  intr_set_level(old_level);
+}
+
+/* Removes and returns the request in BLOCK's queue that its I/O
+   scheduler picks to go next, or a null pointer if the queue is
+   empty.  For use by drivers with a request queue. */
+struct block_request* block_dequeue(struct block* block) {
+  struct block_request* r;
+  enum intr_level old_level = intr_disable();
+  r = block->queue.sched->next(&block->queue);
+  intr_set_level(old_level);
+  return r;
+}
+
+/* Removes and returns a request of at most MAX_CNT sectors from
+   BLOCK's queue that continues PREV, the request just dequeued,
+   in the same direction, or a null pointer if there is none.  A
+   driver may merge such a request into PREV's command. */
+struct block_request* block_dequeue_adjacent(struct block* block, const struct block_request* prev,
+                                             size_t max_cnt) {
+  struct block_request* r;
+  enum intr_level old_level = intr_disable();
+  r = block->queue.sched->next_adjacent(&block->queue, prev, max_cnt);
+  intr_set_level(old_level);
+  return r;
+}
+
+/* Completion function for block_io(). */
+static void block_io_done(struct block_request* r) { sema_up(r->aux); }
+
+/* Transfers the CNT sectors starting at SECTOR between BLOCK and
+   BUFFER as one request, reading from BLOCK unless WRITE, and
+   waits for the transfer to end. */
+static void block_io(struct block* block, block_sector_t sector, size_t cnt, void* buffer,
+                     bool write) {
+  struct semaphore done;
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  sema_init(&done, 0);
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffer = buffer;
+  r.write = write;
+  r.priority = thread_get_priority();
+  r.done = block_io_done;
+  r.aux = &done;
+  block_submit(block, &r);
+  sema_down(&done);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_read(struct block* block, block_sector_t sector, void* buffer) {
-  check_sector(block, sector);
-  block->ops->read(block->aux, sector, buffer);
-  block->read_cnt++;
+  block_io(block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -106,10 +300,42 @@ void block_read(struct block* block, block_sector_t sector, void* buffer) {
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_write(struct block* block, block_sector_t sector, const void* buffer) {
-  check_sector(block, sector);
-  ASSERT(block->type != BLOCK_FOREIGN);
-  block->ops->write(block->aux, sector, buffer);
-  block->write_cnt++;
+  block_io(block, sector, 1, (void*)buffer, true);
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFER, which must have room for CNT *
+   BLOCK_SECTOR_SIZE bytes.  If BLOCK's driver supports it, they
+   are transferred as one request; otherwise, one sector at a
+   time.  Counts as CNT sector reads.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void block_read_multiple(struct block* block, block_sector_t sector, size_t cnt, void* buffer) {
+  block_io(block, sector, cnt, buffer, false);
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   If BLOCK's driver supports it, they are transferred as one
+   request; otherwise, one sector at a time.  Returns after the
+   block device has acknowledged receiving all of the data.
+   Counts as CNT sector writes.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void block_write_multiple(struct block* block, block_sector_t sector, size_t cnt,
+                          const void* buffer) {
+  block_io(block, sector, cnt, (void*)buffer, true);
+}
+
+/* Waits until every write to BLOCK that has completed is on
+   stable storage, not just in the device's write cache.  Writes
+   still in progress are not covered, so a caller that needs one
+   write to reach the media before another starts must wait for
+   the first, flush, and only then submit the second. */
+void block_flush(struct block* block) {
+  ASSERT(!intr_context());
+  if (block->ops->flush != NULL)
+    block->ops->flush(block->aux);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -121,6 +347,20 @@ const char* block_name(struct block* block) { return block->name; }
 /* Returns BLOCK's type. */
 enum block_type block_type(struct block* block) { return block->type; }
 
+/* Prints the nonzero buckets of histogram HIST, which has CNT
+   buckets, after LABEL.  Bucket I is labeled with I, or with
+   2**I if POWERS. */
+static void print_histogram(const char* label, const unsigned* hist, int cnt, bool powers) {
+  int i;
+
+  printf("  %s:", label);
+  for (i = 0; i < cnt; i++)
+    if (hist[i] != 0)
+      printf(" %s%lu:%u", i == cnt - 1 ? ">=" : "", powers ? 1ul << i : (unsigned long)i,
+             hist[i]);
+  printf("\n");
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void block_print_stats(void) {
   int i;
@@ -128,8 +368,17 @@ void block_print_stats(void) {
   for (i = 0; i < BLOCK_ROLE_CNT; i++) {
     struct block* block = block_by_role[i];
     if (block != NULL) {
+      struct blkstat st;
+
       printf("%s (%s): %llu reads, %llu writes\n", block->name, block_type_name(block->type),
-             block->read_cnt, block->write_cnt);
+             block_read_cnt(block), block_write_cnt(block));
+      block_get_stats(block, &st);
+      printf("  %llu read requests, %llu bytes; %llu write requests, %llu bytes\n", st.read_cnt,
+             st.read_bytes, st.write_cnt, st.write_bytes);
+      print_histogram("read latency (us)", st.read_latency, BLKSTAT_LATENCY_CNT, true);
+      print_histogram("write latency (us)", st.write_latency, BLKSTAT_LATENCY_CNT, true);
+      print_histogram("queue depth", st.depth, BLKSTAT_DEPTH_CNT, false);
+      printf("  %llu us polling, %llu sleeps\n", st.poll_usec, st.poll_sleeps);
     }
   }
 }
@@ -153,6 +402,9 @@ struct block* block_register(const char* name, enum block_type type, const char*
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block_queue_init(&block->queue, iosched_default());
+  memset(&block->stats, 0, sizeof block->stats);
+  block->in_flight = 0;
 
   printf("%s: %'" PRDSNu " sectors (", block->name, block->size);
   print_human_readable_size((uint64_t)block->size * BLOCK_SECTOR_SIZE);
@@ -171,4 +423,16 @@ static struct block* list_elem_to_block(struct list_elem* list_elem) {
                                              : NULL);
 }
 
-unsigned long long block_write_cnt(struct block* block) { return block->write_cnt; }
+unsigned long long block_read_cnt(struct block* block) {
+  enum intr_level old_level = intr_disable();
+  unsigned long long cnt = block->read_cnt;
+  intr_set_level(old_level);
+  return cnt;
+}
+
+unsigned long long block_write_cnt(struct block* block) {
+  enum intr_level old_level = intr_disable();
+  unsigned long long cnt = block->write_cnt;
+  intr_set_level(old_level);
+  return cnt;
+}
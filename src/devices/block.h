@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <blkstat.h>
+#include <list.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -52,21 +55,89 @@ struct block* block_next(struct block*);
 block_sector_t block_size(struct block*);
 void block_read(struct block*, block_sector_t, void*);
 void block_write(struct block*, block_sector_t, const void*);
+void block_read_multiple(struct block*, block_sector_t, size_t cnt, void*);
+void block_write_multiple(struct block*, block_sector_t, size_t cnt, const void*);
+void block_flush(struct block*);
 const char* block_name(struct block*);
 enum block_type block_type(struct block*);
+unsigned long long block_read_cnt(struct block* block);
 unsigned long long block_write_cnt(struct block* block);
 
 /* Statistics. */
+void block_get_stats(struct block*, struct blkstat*);
 void block_print_stats(void);
 
+/* Asynchronous requests. */
+struct block_request;
+
+/* Called when block request R completes.  May run in an
+   interrupt handler, so it must not sleep or acquire locks. */
+typedef void block_request_func(struct block_request* r);
+
+/* A request to transfer CNT consecutive sectors starting at
+   SECTOR between a block device and BUFFER, which must be kernel
+   memory and must not be touched until DONE is called.  The
+   block layer and drivers may change SECTOR.  PRIORITY, normally
+   the submitting thread's, lets the I/O scheduler serve urgent
+   requests before background ones. */
+struct block_request {
+  block_sector_t sector;      /* First sector. */
+  size_t cnt;                 /* Number of sectors. */
+  void* buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes of data. */
+  bool write;                 /* Write to the device instead of read? */
+  int priority;               /* PRI_MIN...PRI_MAX. */
+  block_request_func* done;   /* Called on completion. */
+  void* aux;                  /* For use by DONE. */
+  struct list_elem elem;      /* Element in a queue's FIFO list. */
+  struct list_elem sort_elem; /* Element in a queue's sorted list. */
+  int64_t deadline;           /* Timer tick by which to dispatch. */
+  struct block* block;        /* Device submitted to, for statistics. */
+  int64_t start;              /* timer_usec() at submission. */
+};
+
+void block_submit(struct block*, struct block_request*);
+
 /* Lower-level interface to block device drivers. */
 
 struct block_operations {
   void (*read)(void* aux, block_sector_t, void* buffer);
   void (*write)(void* aux, block_sector_t, const void* buffer);
+
+  /* Transfer CNT consecutive sectors in one request.  Optional:
+     if null, the block layer calls read or write once per
+     sector instead. */
+  void (*read_multiple)(void* aux, block_sector_t, size_t cnt, void* buffer);
+  void (*write_multiple)(void* aux, block_sector_t, size_t cnt, const void* buffer);
+
+  /* Optional.  If non-null, block_submit() hands every request
+     to this function instead of queuing it, as a partition does
+     to pass it on to its disk with block_forward(). */
+  void (*submit)(void* aux, struct block_request*);
+
+  /* Optional.  If non-null, the device has a request queue, and
+     block_submit() calls this function after queuing a request,
+     possibly from an interrupt handler, so that the driver's
+     dispatcher takes it with block_dequeue() and passes it to
+     block_complete() when the transfer ends.  The read and write
+     functions are then never called.  If both SUBMIT and KICK
+     are null, requests are carried out at once by the read and
+     write functions. */
+  void (*kick)(void* aux);
+
+  /* Optional.  Makes every write that completed before the call
+     stable, by writing back the device's volatile write cache,
+     and returns once it is.  Must not be called from an interrupt
+     handler.  If null, writes are stable once they complete. */
+  void (*flush)(void* aux);
 };
 
 struct block* block_register(const char* name, enum block_type, const char* extra_info,
                              block_sector_t size, const struct block_operations*, void* aux);
+void block_forward(struct block*, struct block_request*);
+void block_complete(struct block_request*);
+void block_add_poll_time(struct block_request*, int64_t usec, unsigned sleeps);
+struct block_request* block_dequeue(struct block*);
+struct block_request* block_dequeue_adjacent(struct block*, const struct block_request* prev,
+                                             size_t max_cnt);
 
 #endif /* devices/block.h */
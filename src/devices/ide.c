@@ -5,17 +5,36 @@
 #include <stdio.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  If the
+   controller is a PCI bus master, such as the PIIX that QEMU
+   emulates, sectors move by DMA; otherwise, or if a transfer
+   cannot use DMA, they move by programmed I/O.
+
+   Each disk has a request queue in the block layer, ordered by
+   its I/O scheduler.  A dispatcher thread per channel takes
+   requests from its disks' queues in turn, merges each with any
+   queued requests for the sectors that follow it, and issues the
+   commands for them, and the interrupt handler moves PIO data and
+   completes the requests.  Callers thus never wait for the
+   channel, only for their own requests.
+
+   Disks run with their write cache on if they can flush it, and
+   the dispatcher also carries out the cache flushes that
+   block_flush() asks for. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)   /* Data. */
 #define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)  /* Error. */
+#define reg_features(CHANNEL) reg_error(CHANNEL)      /* Features (w/o). */
 #define reg_nsect(CHANNEL) ((CHANNEL)->reg_base + 2)  /* Sector Count. */
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)   /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)   /* LBA 15:8. */
@@ -30,10 +49,25 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206) /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl(CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's
+   bus master base, which is 0 if the channel has none. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Bus Master Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Bus Master Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD Table Address. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
+
+/* Bus Master Command Register bits. */
+#define BM_CMD_START 0x01 /* Start transfer. */
+#define BM_CMD_READ 0x08  /* Transfer from disk to memory. */
+
+/* Bus Master Status Register bits. */
+#define BM_STA_ERR 0x02  /* DMA error (write 1 to clear). */
+#define BM_STA_INTR 0x04 /* Interrupt raised (write 1 to clear). */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -49,6 +83,43 @@
 #define CMD_IDENTIFY_DEVICE 0xec    /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20  /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4      /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5     /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6  /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8           /* READ DMA. */
+#define CMD_WRITE_DMA 0xca          /* WRITE DMA. */
+#define CMD_FLUSH_CACHE 0xe7        /* FLUSH CACHE. */
+#define CMD_SET_FEATURES 0xef       /* SET FEATURES. */
+
+/* SET FEATURES subcommands, written to the Features register. */
+#define SETF_WCACHE_ON 0x02 /* Enable volatile write cache. */
+
+/* Most sectors one command transfers.  A Sector Count of 0
+   stands for this many. */
+#define ATA_MAX_SECTORS 256
+
+/* A Physical Region Descriptor, which tells the bus master where
+   one physically contiguous piece of a transfer goes.  A channel's
+   PRD table lists the pieces of a whole transfer in order. */
+struct prd {
+  uint32_t addr;  /* Physical address, even. */
+  uint16_t size;  /* Byte count, with 0 meaning 64 kB. */
+  uint16_t flags; /* PRD_EOT on the table's last entry. */
+};
+
+#define PRD_EOT 0x8000       /* End of table. */
+#define PRD_CNT 32           /* Entries in a PRD table. */
+#define PRD_BOUNDARY 0x10000 /* No piece may cross a multiple of this. */
+
+/* Most requests the dispatcher merges into one transfer. */
+#define BATCH_MAX 16
+
+/* How long to spin on a status register, in microseconds, before
+   sleeping between reads.  Waits that end in an interrupt block
+   on the channel's completion_wait first, so a status read after
+   one, or after a command is accepted, is nearly always ready
+   within a few reads; only slow waits, such as a reset, sleep. */
+#define SPIN_USEC 20
 
 /* An ATA device. */
 struct ata_disk {
@@ -56,6 +127,15 @@ struct ata_disk {
   struct channel* channel; /* Channel that disk is attached to. */
   int dev_no;              /* Device 0 or 1 for master or slave. */
   bool is_ata;             /* Is device an ATA disk? */
+  bool dma;                /* Transfer sectors by DMA? */
+  int multiple;            /* Sectors per READ/WRITE MULTIPLE block, or 0. */
+  bool write_cache;        /* Is the disk's volatile write cache on? */
+  struct block* block;     /* Block device, once registered. */
+
+  /* Cache flushes, which the dispatcher carries out. */
+  struct lock flush_lock;      /* Allows one flush at a time. */
+  bool flush_pending;          /* Has a flush been asked for? */
+  struct semaphore flush_done; /* Up'd by the dispatcher after a flush. */
 };
 
 /* An ATA channel (aka controller).
@@ -63,12 +143,32 @@ struct ata_disk {
 struct channel {
   char name[8];      /* Name, e.g. "ide0". */
   uint16_t reg_base; /* Base I/O port. */
+  uint16_t bm_base;  /* Bus master I/O port, or 0 if none. */
+  struct prd* prdt;  /* PRD table for DMA. */
   uint8_t irq;       /* Interrupt in use. */
 
-  struct lock lock;                 /* Must acquire to access the controller. */
   bool expecting_interrupt;         /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
+  int selected;                     /* Device last selected, or -1 if unknown. */
   struct semaphore completion_wait; /* Up'd by interrupt handler. */
+  struct semaphore request_wait;    /* Up'd once per request queued. */
+
+  /* The transfer in progress, shared by the dispatcher and the
+     interrupt handler.  It carries out BATCH_CNT requests for
+     consecutive sectors, in the same direction, in order. */
+  struct block_request* batch[BATCH_MAX]; /* Requests in the transfer. */
+  size_t batch_cnt;                       /* Number of requests in BATCH. */
+  size_t batch_idx;                       /* Index of REQUEST in BATCH. */
+  struct block_request* request;          /* Request in progress, or null. */
+  struct ata_disk* disk;                  /* Disk that the transfer is for. */
+  bool write;                             /* Is the transfer a write? */
+  block_sector_t sec_no;                  /* Next sector to transfer. */
+  uint8_t* buffer;                        /* Data for sector SEC_NO. */
+  size_t left;                            /* Sectors left in the transfer. */
+  size_t req_left;                        /* Sectors left in REQUEST. */
+  size_t cmd_left;                        /* Sectors left in the current command. */
+  bool cmd_dma;                           /* Is the current command DMA? */
+  bool cmd_failed;                        /* Did the current command fail? */
 
   struct ata_disk devices[2]; /* The devices on this channel. */
 };
@@ -77,17 +177,34 @@ struct channel {
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Each channel's PRD table.  Aligning a table to its own size
+   keeps it from crossing a 64 kB boundary, as the bus master
+   requires. */
+static struct prd prd_tables[CHANNEL_CNT][PRD_CNT]
+    __attribute__((aligned(PRD_CNT * sizeof(struct prd))));
+
 static struct block_operations ide_operations;
 
+static uint16_t find_bus_master(void);
 static void reset_channel(struct channel*);
 static bool check_device_type(struct ata_disk*);
 static void identify_ata_device(struct ata_disk*);
 
-static void select_sector(struct ata_disk*, block_sector_t);
-static void issue_pio_command(struct channel*, uint8_t command);
-static void input_sector(struct channel*, void*);
-static void output_sector(struct channel*, const void*);
-
+static void set_multiple_mode(struct ata_disk*, int multiple);
+static void enable_write_cache(struct ata_disk*);
+
+static void select_sector(struct ata_disk*, block_sector_t, size_t cnt);
+static void issue_command(struct channel*, uint8_t command);
+static void dispatch_thread(void* c_);
+static void do_transfer(struct channel*, struct ata_disk*);
+static void do_flush(struct channel*, struct ata_disk*);
+static bool start_dma(struct channel*, size_t cnt);
+static void start_pio(struct channel*, size_t cnt);
+static void request_interrupt(struct channel*);
+static void input_sectors(struct channel*, void*, size_t cnt);
+static void output_sectors(struct channel*, const void*, size_t cnt);
+
+static uint8_t wait_status(struct channel*, uint16_t port, uint8_t mask, int64_t timeout_usec);
 static void wait_until_idle(const struct ata_disk*);
 static bool wait_while_busy(const struct ata_disk*);
 static void select_device(const struct ata_disk*);
@@ -97,6 +214,7 @@ static void interrupt_handler(struct intr_frame*);
 
 /* Initialize the disk subsystem and detect disks. */
 void ide_init(void) {
+  uint16_t bm_base = find_bus_master();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -117,9 +235,13 @@ void ide_init(void) {
       default:
         NOT_REACHED();
     }
-    lock_init(&c->lock);
+    c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+    c->prdt = prd_tables[chan_no];
     c->expecting_interrupt = false;
+    c->selected = -1;
     sema_init(&c->completion_wait, 0);
+    sema_init(&c->request_wait, 0);
+    c->request = NULL;
 
     /* Initialize devices. */
     for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -128,6 +250,13 @@ void ide_init(void) {
       d->channel = c;
       d->dev_no = dev_no;
       d->is_ata = false;
+      d->dma = false;
+      d->multiple = 0;
+      d->write_cache = false;
+      d->block = NULL;
+      lock_init(&d->flush_lock);
+      d->flush_pending = false;
+      sema_init(&d->flush_done, 0);
     }
 
     /* Register interrupt handler. */
@@ -140,6 +269,11 @@ void ide_init(void) {
     if (check_device_type(&c->devices[0]))
       check_device_type(&c->devices[1]);
 
+    /* Start the dispatcher before registering any disk, since
+       partition_scan() reads through it. */
+    if (c->devices[0].is_ata || c->devices[1].is_ata)
+      thread_create(c->name, PRI_MAX, dispatch_thread, c);
+
     /* Read hard disk identity information. */
     for (dev_no = 0; dev_no < 2; dev_no++)
       if (c->devices[dev_no].is_ata)
@@ -151,6 +285,27 @@ void ide_init(void) {
 
 static char* descramble_ata_string(char*, int size);
 
+/* Looks for a PCI IDE controller that can master the bus and
+   drives the two legacy channels at their usual ports.  If there
+   is one, enables bus mastering and returns the base of its bus
+   master ports, which are 8 for the first channel followed by 8
+   for the second.  Otherwise returns 0. */
+static uint16_t find_bus_master(void) {
+  struct pci_dev dev;
+  uint16_t base;
+
+  /* Programming interface bit 7 means the controller can master
+     the bus.  Bits 0 and 2 mean a channel has moved away from
+     its legacy ports, which we do not support. */
+  if (!pci_find_class(0x01, 0x01, &dev) || (dev.prog_if & 0x85) != 0x80)
+    return 0;
+
+  base = pci_io_base(&dev, 4);
+  if (base != 0)
+    pci_enable_bus_master(&dev);
+  return base;
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void reset_channel(struct channel* c) {
@@ -183,6 +338,7 @@ static void reset_channel(struct channel* c) {
   outb(reg_ctl(c), CTL_SRST);
   timer_usleep(10);
   outb(reg_ctl(c), 0);
+  c->selected = -1;
 
   timer_msleep(150);
 
@@ -249,13 +405,13 @@ static void identify_ata_device(struct ata_disk* d) {
      indicating the device's response is ready, and read the data
      into our buffer. */
   select_device_wait(d);
-  issue_pio_command(c, CMD_IDENTIFY_DEVICE);
+  issue_command(c, CMD_IDENTIFY_DEVICE);
   sema_down(&c->completion_wait);
   if (!wait_while_busy(d)) {
     d->is_ata = false;
     return;
   }
-  input_sector(c, id);
+  input_sectors(c, id, 1);
 
   /* Calculate capacity.
      Read model name and serial number. */
@@ -264,6 +420,10 @@ static void identify_ata_device(struct ata_disk* d) {
   serial = descramble_ata_string(&id[27 * 2], 40);
   snprintf(extra_info, sizeof extra_info, "model \"%s\", serial \"%s\"", model, serial);
 
+  /* Use DMA if both the controller and the disk support it.  Word
+     49 bit 8 of the identity says the disk does. */
+  d->dma = c->bm_base != 0 && (*(uint16_t*)&id[49 * 2] & (1 << 8)) != 0;
+
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
@@ -277,8 +437,19 @@ static void identify_ata_device(struct ata_disk* d) {
     return;
   }
 
+  /* Word 47 bits 7:0 give the most sectors per READ/WRITE
+     MULTIPLE block, or 0 if the disk lacks those commands. */
+  set_multiple_mode(d, (uint8_t)id[47 * 2]);
+
+  /* Word 82 bit 5 says the disk has a write cache, word 83 bit 12
+     that it has FLUSH CACHE.  We only turn on a cache we can
+     flush. */
+  if ((*(uint16_t*)&id[82 * 2] & (1 << 5)) != 0 && (*(uint16_t*)&id[83 * 2] & (1 << 12)) != 0)
+    enable_write_cache(d);
+
   /* Register. */
   block = block_register(d->name, BLOCK_RAW, extra_info, capacity, &ide_operations, d);
+  d->block = block;
   partition_scan(block);
 }
 
@@ -306,53 +477,172 @@ static char* descramble_ata_string(char* string, int size) {
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_read(void* d_, block_sector_t sec_no, void* buffer) {
-  struct ata_disk* d = d_;
+/* Sets the number of sectors that disk D transfers per block of
+   READ MULTIPLE and WRITE MULTIPLE to MULTIPLE.  If MULTIPLE is
+   0 or the disk refuses, PIO transfers fall back to READ SECTOR
+   and WRITE SECTOR. */
+static void set_multiple_mode(struct ata_disk* d, int multiple) {
   struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_READ_SECTOR_RETRY);
+
+  d->multiple = 0;
+  if (multiple == 0)
+    return;
+
+  select_device_wait(d);
+  outb(reg_nsect(c), multiple);
+  issue_command(c, CMD_SET_MULTIPLE_MODE);
   sema_down(&c->completion_wait);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-  input_sector(c, buffer);
-  lock_release(&c->lock);
+  wait_while_busy(d);
+  if ((inb(reg_alt_status(c)) & STA_ERR) == 0)
+    d->multiple = multiple;
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_write(void* d_, block_sector_t sec_no, const void* buffer) {
-  struct ata_disk* d = d_;
+/* Turns on disk D's volatile write cache, so that a write
+   completes once the disk has the data, and sets D's write_cache
+   member if the disk agrees.  The file system then makes its
+   writes stable with block_flush() where it needs them to be. */
+static void enable_write_cache(struct ata_disk* d) {
   struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-  output_sector(c, buffer);
+
+  select_device_wait(d);
+  outb(reg_features(c), SETF_WCACHE_ON);
+  issue_command(c, CMD_SET_FEATURES);
   sema_down(&c->completion_wait);
-  lock_release(&c->lock);
+  wait_while_busy(d);
+  d->write_cache = (inb(reg_alt_status(c)) & STA_ERR) == 0;
 }
 
-static struct block_operations ide_operations = {ide_read, ide_write};
+/* Tells disk D's dispatcher that a request has been queued.
+   Called by the block layer, possibly from an interrupt
+   handler. */
+static void ide_kick(void* d_) {
+  struct ata_disk* d = d_;
+  sema_up(&d->channel->request_wait);
+}
+
+/* Has disk D_'s dispatcher write back the disk's write cache, and
+   waits for it to finish. */
+static void ide_flush(void* d_) {
+  struct ata_disk* d = d_;
+
+  if (!d->write_cache)
+    return;
+  lock_acquire(&d->flush_lock);
+  d->flush_pending = true;
+  sema_up(&d->channel->request_wait);
+  sema_down(&d->flush_done);
+  lock_release(&d->flush_lock);
+}
+
+static struct block_operations ide_operations = {.kick = ide_kick, .flush = ide_flush};
+
+/* Dispatcher for channel C_.  Takes the requests queued for the
+   channel's disks, alternating between the disks if both have
+   some, and carries them out one transfer at a time. */
+static void dispatch_thread(void* c_) {
+  struct channel* c = c_;
+  int next_dev = 0;
+
+  for (;;) {
+    struct block_request* r = NULL;
+    struct ata_disk* d = NULL;
+    size_t sector_cnt;
+    int i;
+
+    /* REQUEST_WAIT counts queued requests and flushes, but a
+       request merged into an earlier transfer, or a flush that
+       is noticed early, is taken without a down, so there may
+       turn out to be nothing to do.  Flushes go first, since
+       their callers only need the writes completed before. */
+    sema_down(&c->request_wait);
+    for (i = 0; i < 2; i++)
+      if (c->devices[i].flush_pending)
+        do_flush(c, &c->devices[i]);
+    for (i = 0; i < 2 && r == NULL; i++) {
+      d = &c->devices[(next_dev + i) % 2];
+      if (d->block != NULL)
+        r = block_dequeue(d->block);
+    }
+    if (r == NULL)
+      continue;
+    next_dev = (d->dev_no + 1) % 2;
+
+    /* Merge requests for the following sectors, as long as the
+       transfer still fits in one command. */
+    c->batch[0] = r;
+    c->batch_cnt = 1;
+    sector_cnt = r->cnt;
+    while (c->batch_cnt < BATCH_MAX && sector_cnt < ATA_MAX_SECTORS) {
+      r = block_dequeue_adjacent(d->block, r, ATA_MAX_SECTORS - sector_cnt);
+      if (r == NULL)
+        break;
+      c->batch[c->batch_cnt++] = r;
+      sector_cnt += r->cnt;
+    }
+
+    do_transfer(c, d);
+  }
+}
+
+/* Carries out the requests in channel C's batch for disk D with
+   as many commands of up to ATA_MAX_SECTORS sectors as they need,
+   using DMA where possible.  The interrupt handler completes the
+   requests. */
+static void do_transfer(struct channel* c, struct ata_disk* d) {
+  struct block_request* r = c->batch[0];
+  size_t i;
+
+  c->disk = d;
+  c->write = r->write;
+  c->sec_no = r->sector;
+  c->buffer = r->buffer;
+  c->left = 0;
+  for (i = 0; i < c->batch_cnt; i++)
+    c->left += c->batch[i]->cnt;
+  c->req_left = r->cnt;
+  c->batch_idx = 0;
+  c->request = r;
+
+  while (c->left > 0) {
+    size_t cnt = c->left < ATA_MAX_SECTORS ? c->left : ATA_MAX_SECTORS;
+
+    /* A PIO command stays within one request, so that no block of
+       PIO data straddles two buffers. */
+    if (!d->dma || !start_dma(c, cnt))
+      start_pio(c, cnt < c->req_left ? cnt : c->req_left);
+    sema_down(&c->completion_wait);
+
+    if (c->cmd_failed) {
+      printf("%s: DMA %s failed, sector=%" PRDSNu ", falling back to PIO\n", d->name,
+             c->write ? "write" : "read", c->sec_no);
+      d->dma = false;
+    }
+  }
+}
+
+/* Carries out the cache flush asked of disk D by ide_flush(). */
+static void do_flush(struct channel* c, struct ata_disk* d) {
+  d->flush_pending = false;
+  select_device_wait(d);
+  issue_command(c, CMD_FLUSH_CACHE);
+  sema_down(&c->completion_wait);
+  if ((inb(reg_alt_status(c)) & STA_ERR) != 0)
+    PANIC("%s: cache flush failed", d->name);
+  sema_up(&d->flush_done);
+}
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void select_sector(struct ata_disk* d, block_sector_t sec_no) {
+   writes SEC_NO and the count CNT, which must be between 1 and
+   ATA_MAX_SECTORS, to the disk's sector selection registers.
+   (We use LBA mode.) */
+static void select_sector(struct ata_disk* d, block_sector_t sec_no, size_t cnt) {
   struct channel* c = d->channel;
 
   ASSERT(sec_no < (1UL << 28));
+  ASSERT(cnt > 0 && cnt <= ATA_MAX_SECTORS);
 
   select_device_wait(d);
-  outb(reg_nsect(c), 1);
+  outb(reg_nsect(c), cnt % ATA_MAX_SECTORS);
   outb(reg_lbal(c), sec_no);
   outb(reg_lbam(c), sec_no >> 8);
   outb(reg_lbah(c), (sec_no >> 16));
@@ -361,7 +651,7 @@ static void select_sector(struct ata_disk* d, block_sector_t sec_no) {
 
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
-static void issue_pio_command(struct channel* c, uint8_t command) {
+static void issue_command(struct channel* c, uint8_t command) {
   /* Interrupts must be enabled or our semaphore will never be
      up'd by the completion handler. */
   ASSERT(intr_get_level() == INTR_ON);
@@ -370,35 +660,239 @@ static void issue_pio_command(struct channel* c, uint8_t command) {
   outb(reg_command(c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
-static void input_sector(struct channel* c, void* sector) {
-  insw(reg_data(c), sector, BLOCK_SECTOR_SIZE / 2);
+/* Fills in channel C's PRD table to describe the buffers for the
+   next CNT sectors of its batch, starting at C->buffer and going
+   on through the buffers of the requests that follow.  Returns
+   false if the bus master cannot reach one of the buffers,
+   because it is not kernel memory or is not word-aligned, or if
+   the buffers need more than PRD_CNT pieces. */
+static bool build_prdt(struct channel* c, size_t cnt) {
+  const uint8_t* buffer = c->buffer;
+  size_t buffer_cnt = c->req_left;
+  size_t idx = c->batch_idx;
+  size_t i = 0;
+
+  ASSERT(cnt > 0 && cnt <= c->left);
+
+  while (cnt > 0) {
+    size_t size;
+    uintptr_t paddr;
+
+    if (!is_kernel_vaddr(buffer) || (uintptr_t)buffer % 2 != 0)
+      return false;
+    if (buffer_cnt > cnt)
+      buffer_cnt = cnt;
+    cnt -= buffer_cnt;
+
+    /* Kernel virtual memory maps physical memory one-to-one, so
+       each buffer is physically contiguous and only needs
+       splitting at 64 kB boundaries. */
+    paddr = vtop(buffer);
+    for (size = buffer_cnt * BLOCK_SECTOR_SIZE; size > 0; i++) {
+      size_t chunk_size = PRD_BOUNDARY - paddr % PRD_BOUNDARY;
+
+      if (i >= PRD_CNT)
+        return false;
+      if (chunk_size > size)
+        chunk_size = size;
+      c->prdt[i].addr = paddr;
+      c->prdt[i].size = chunk_size;
+      c->prdt[i].flags = 0;
+      paddr += chunk_size;
+      size -= chunk_size;
+    }
+
+    if (cnt > 0) {
+      idx++;
+      buffer = c->batch[idx]->buffer;
+      buffer_cnt = c->batch[idx]->cnt;
+    }
+  }
+  c->prdt[i - 1].flags = PRD_EOT;
+  return true;
+}
+
+/* Starts a DMA command on channel C for the next CNT sectors of
+   its batch.  Returns false, without touching the disk, if the
+   bus master cannot reach the buffers. */
+static bool start_dma(struct channel* c, size_t cnt) {
+  uint8_t direction = c->write ? 0 : BM_CMD_READ;
+
+  if (!build_prdt(c, cnt))
+    return false;
+
+  /* Point the bus master at the PRD table, set the direction, and
+     clear old status.  The barrier makes sure the table is in
+     memory before the bus master can read it. */
+  barrier();
+  outl(reg_bm_prdt(c), vtop(c->prdt));
+  outb(reg_bm_command(c), direction);
+  outb(reg_bm_status(c), BM_STA_ERR | BM_STA_INTR);
+
+  /* Start the disk, then the bus master. */
+  c->cmd_dma = true;
+  c->cmd_failed = false;
+  c->cmd_left = cnt;
+  select_sector(c->disk, c->sec_no, cnt);
+  issue_command(c, c->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb(reg_bm_command(c), direction | BM_CMD_START);
+  return true;
+}
+
+/* Returns the number of sectors that the next data request of
+   channel C's PIO command moves: a block of the disk's multiple
+   sectors with READ/WRITE MULTIPLE, a single sector otherwise. */
+static size_t pio_block_cnt(const struct channel* c) {
+  size_t block_cnt = c->disk->multiple > 0 ? c->disk->multiple : 1;
+  return c->cmd_left < block_cnt ? c->cmd_left : block_cnt;
+}
+
+/* Starts a PIO command on channel C for the next CNT sectors of
+   its current request, using READ/WRITE MULTIPLE if the disk supports
+   them and READ/WRITE SECTOR otherwise.  For a write, also sends
+   the first block, after which the interrupt handler takes
+   over. */
+static void start_pio(struct channel* c, size_t cnt) {
+  struct ata_disk* d = c->disk;
+  bool write = c->write;
+  uint8_t command;
+
+  ASSERT(cnt <= c->req_left);
+
+  if (write)
+    command = d->multiple > 0 ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY;
+  else
+    command = d->multiple > 0 ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY;
+
+  c->cmd_dma = false;
+  c->cmd_failed = false;
+  c->cmd_left = cnt;
+  select_sector(d, c->sec_no, cnt);
+  issue_command(c, command);
+  if (write) {
+    if (!wait_while_busy(d))
+      PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, c->sec_no);
+    output_sectors(c, c->buffer, pio_block_cnt(c));
+  }
+}
+
+/* Records that channel C moved CNT more sectors of its batch,
+   completing each request that this finishes. */
+static void advance_request(struct channel* c, size_t cnt) {
+  c->sec_no += cnt;
+  c->left -= cnt;
+  c->cmd_left -= cnt;
+  while (cnt > 0) {
+    size_t req_cnt = cnt < c->req_left ? cnt : c->req_left;
+    struct block_request* r = c->request;
+
+    c->buffer += req_cnt * BLOCK_SECTOR_SIZE;
+    c->req_left -= req_cnt;
+    cnt -= req_cnt;
+    if (c->req_left == 0) {
+      c->request = ++c->batch_idx < c->batch_cnt ? c->batch[c->batch_idx] : NULL;
+      if (c->request != NULL) {
+        c->buffer = c->request->buffer;
+        c->req_left = c->request->cnt;
+      }
+      block_complete(r);
+    }
+  }
+}
+
+/* Handles an interrupt for channel C's current command.  Moves
+   the next block of PIO data, if any, and when the command ends
+   wakes the dispatcher. */
+static void request_interrupt(struct channel* c) {
+  struct ata_disk* d = c->disk;
+  bool write = c->write;
+  uint8_t status = inb(reg_status(c)); /* Acknowledge interrupt. */
+
+  if (c->cmd_dma) {
+    /* Stop the bus master and check for errors from it or the
+       disk.  On failure, the dispatcher retries by PIO. */
+    uint8_t bm_status;
+    outb(reg_bm_command(c), write ? 0 : BM_CMD_READ);
+    bm_status = inb(reg_bm_status(c));
+    outb(reg_bm_status(c), BM_STA_ERR | BM_STA_INTR);
+    if ((bm_status & BM_STA_ERR) != 0 || (status & (STA_BSY | STA_ERR)) != 0)
+      c->cmd_failed = true;
+    else
+      advance_request(c, c->cmd_left);
+  } else {
+    /* The disk interrupts once per block: after a block of a
+       read is ready, and after a block of a write is taken. */
+    size_t block_cnt = pio_block_cnt(c);
+    if ((status & STA_ERR) != 0 || (!write && (status & STA_DRQ) == 0))
+      PANIC("%s: disk %s failed, sector=%" PRDSNu, d->name, write ? "write" : "read",
+            c->sec_no);
+    if (!write)
+      input_sectors(c, c->buffer, block_cnt);
+    advance_request(c, block_cnt);
+    if (write && c->cmd_left > 0)
+      output_sectors(c, c->buffer, pio_block_cnt(c));
+    if (c->cmd_left > 0)
+      return;
+  }
+
+  sema_up(&c->completion_wait);
+}
+
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void input_sectors(struct channel* c, void* sectors, size_t cnt) {
+  insw(reg_data(c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
-static void output_sector(struct channel* c, const void* sector) {
-  outsw(reg_data(c), sector, BLOCK_SECTOR_SIZE / 2);
+/* Writes CNT sectors from SECTORS to channel C's data register in
+   PIO mode.  SECTORS must contain CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void output_sectors(struct channel* c, const void* sectors, size_t cnt) {
+  outsw(reg_data(c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
 
-/* Wait up to 10 seconds for the controller to become idle, that
+/* Reads channel C's status from PORT until none of the bits in
+   MASK are set or TIMEOUT_USEC microseconds pass, and returns
+   the last status read.  Spins for the first SPIN_USEC
+   microseconds and only then sleeps a timer tick between reads,
+   so that a disk that answers promptly costs no more than the
+   reads and a slow one does not hold the CPU.  The time and the
+   sleeps are charged to C's request in progress, if any. */
+static uint8_t wait_status(struct channel* c, uint16_t port, uint8_t mask, int64_t timeout_usec) {
+  int64_t start = timer_usec();
+  int64_t elapsed;
+  unsigned sleeps = 0;
+  uint8_t status;
+
+  for (;;) {
+    status = inb(port);
+    elapsed = timer_usec() - start;
+    if ((status & mask) == 0 || elapsed >= timeout_usec)
+      break;
+    if (elapsed >= SPIN_USEC) {
+      timer_sleep(1);
+      sleeps++;
+    }
+  }
+
+  if (c->request != NULL)
+    block_add_poll_time(c->request, elapsed, sleeps);
+  return status;
+}
+
+/* Wait up to 10 ms for the controller to become idle, that
    is, for the BSY and DRQ bits to clear in the status register.
 
    As a side effect, reading the status register clears any
    pending interrupt. */
 static void wait_until_idle(const struct ata_disk* d) {
-  int i;
-
-  for (i = 0; i < 1000; i++) {
-    if ((inb(reg_status(d->channel)) & (STA_BSY | STA_DRQ)) == 0)
-      return;
-    timer_usleep(10);
-  }
+  struct channel* c = d->channel;
 
-  printf("%s: idle timeout\n", d->name);
+  if ((wait_status(c, reg_status(c), STA_BSY | STA_DRQ, 10 * 1000) & (STA_BSY | STA_DRQ)) != 0)
+    printf("%s: idle timeout\n", d->name);
 }
 
 /* Wait up to 30 seconds for disk D to clear BSY,
@@ -407,40 +901,48 @@ static void wait_until_idle(const struct ata_disk* d) {
    complete its reset. */
 static bool wait_while_busy(const struct ata_disk* d) {
   struct channel* c = d->channel;
-  int i;
 
-  for (i = 0; i < 3000; i++) {
-    if (i == 700)
-      printf("%s: busy, waiting...", d->name);
-    if (!(inb(reg_alt_status(c)) & STA_BSY)) {
-      if (i >= 700)
-        printf("ok\n");
-      return (inb(reg_alt_status(c)) & STA_DRQ) != 0;
+  if ((wait_status(c, reg_alt_status(c), STA_BSY, 7 * 1000 * 1000) & STA_BSY) != 0) {
+    printf("%s: busy, waiting...", d->name);
+    if ((wait_status(c, reg_alt_status(c), STA_BSY, 23 * 1000 * 1000) & STA_BSY) != 0) {
+      printf("failed\n");
+      return false;
     }
-    timer_msleep(10);
+    printf("ok\n");
   }
-
-  printf("failed\n");
-  return false;
+  return (inb(reg_alt_status(c)) & STA_DRQ) != 0;
 }
 
-/* Program D's channel so that D is now the selected disk. */
+/* Program D's channel so that D is now the selected disk, unless
+   it already is. */
 static void select_device(const struct ata_disk* d) {
   struct channel* c = d->channel;
   uint8_t dev = DEV_MBS;
+  int i;
+
+  if (c->selected == d->dev_no)
+    return;
   if (d->dev_no == 1)
     dev |= DEV_DEV;
   outb(reg_device(c), dev);
-  inb(reg_alt_status(c));
-  timer_nsleep(400);
+
+  /* Each read of the alternate status register takes at least
+     100 ns, so four of them give the disk the 400 ns it may need
+     to put its status on the bus. */
+  for (i = 0; i < 4; i++)
+    inb(reg_alt_status(c));
+  c->selected = d->dev_no;
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
-   the channel to become idle before and after. */
+   the channel to become idle before and, if D was not already
+   selected, after. */
 static void select_device_wait(const struct ata_disk* d) {
   wait_until_idle(d);
-  select_device(d);
-  wait_until_idle(d);
+  if (d->channel->selected != d->dev_no) {
+    select_device(d);
+    wait_until_idle(d);
+  }
 }
 
 /* ATA interrupt handler. */
@@ -449,7 +951,9 @@ static void interrupt_handler(struct intr_frame* f) {
 
   for (c = channels; c < channels + CHANNEL_CNT; c++)
     if (f->vec_no == c->irq) {
-      if (c->expecting_interrupt) {
+      if (c->request != NULL)
+        request_interrupt(c);
+      else if (c->expecting_interrupt) {
         inb(reg_status(c));           /* Acknowledge interrupt. */
         sema_up(&c->completion_wait); /* Wake up waiter. */
       } else
@@ -0,0 +1,168 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/thread.h"
+
+/* Timer ticks a request may wait in a deadline queue before it is
+   dispatched ahead of everything else.  Reads usually have a
+   thread waiting on them, so they expire sooner than writes. */
+#define READ_EXPIRE (TIMER_FREQ / 20)
+#define WRITE_EXPIRE (TIMER_FREQ / 2)
+
+/* Initializes Q as an empty queue ordered by SCHED. */
+void block_queue_init(struct block_queue* q, const struct iosched* sched) {
+  q->sched = sched;
+  list_init(&q->fifo);
+  list_init(&q->sorted);
+  q->head = 0;
+}
+
+/* Returns true if R may be merged after PREV into a command of
+   at most MAX_CNT sectors. */
+static bool is_adjacent(const struct block_request* r, const struct block_request* prev,
+                        size_t max_cnt) {
+  return r->write == prev->write && r->sector == prev->sector + prev->cnt && r->cnt <= max_cnt;
+}
+
+/* No-op scheduler: dispatches requests in arrival order, merging
+   a request only with the one that arrived just before it. */
+
+static void noop_add(struct block_queue* q, struct block_request* r) {
+  list_push_back(&q->fifo, &r->elem);
+}
+
+static struct block_request* noop_next(struct block_queue* q) {
+  if (list_empty(&q->fifo))
+    return NULL;
+  return list_entry(list_pop_front(&q->fifo), struct block_request, elem);
+}
+
+static struct block_request* noop_next_adjacent(struct block_queue* q,
+                                                const struct block_request* prev, size_t max_cnt) {
+  struct block_request* r;
+
+  if (list_empty(&q->fifo))
+    return NULL;
+  r = list_entry(list_front(&q->fifo), struct block_request, elem);
+  if (!is_adjacent(r, prev, max_cnt))
+    return NULL;
+  list_remove(&r->elem);
+  return r;
+}
+
+static const struct iosched iosched_noop = {
+    .name = "noop",
+    .add = noop_add,
+    .next = noop_next,
+    .next_adjacent = noop_next_adjacent,
+};
+
+/* Deadline scheduler: an elevator that sweeps the disk in one
+   direction, serving requests from the highest-priority threads
+   first, except that a request whose deadline has passed goes
+   before all others so that none starves.  Q->fifo is kept in
+   deadline order and Q->sorted in sector order. */
+
+static bool deadline_less(const struct list_elem* a_, const struct list_elem* b_,
+                          void* aux UNUSED) {
+  const struct block_request* a = list_entry(a_, struct block_request, elem);
+  const struct block_request* b = list_entry(b_, struct block_request, elem);
+  return a->deadline < b->deadline;
+}
+
+static bool sector_less(const struct list_elem* a_, const struct list_elem* b_,
+                        void* aux UNUSED) {
+  const struct block_request* a = list_entry(a_, struct block_request, sort_elem);
+  const struct block_request* b = list_entry(b_, struct block_request, sort_elem);
+  return a->sector < b->sector;
+}
+
+static void deadline_add(struct block_queue* q, struct block_request* r) {
+  r->deadline = timer_ticks() + (r->write ? WRITE_EXPIRE : READ_EXPIRE);
+  list_insert_ordered(&q->fifo, &r->elem, deadline_less, NULL);
+  list_insert_ordered(&q->sorted, &r->sort_elem, sector_less, NULL);
+}
+
+/* Removes R from Q and moves Q's head just past it. */
+static struct block_request* deadline_take(struct block_queue* q, struct block_request* r) {
+  list_remove(&r->elem);
+  list_remove(&r->sort_elem);
+  q->head = r->sector + r->cnt;
+  return r;
+}
+
+static struct block_request* deadline_next(struct block_queue* q) {
+  struct block_request* first = NULL;
+  struct block_request* ahead = NULL;
+  struct block_request* r;
+  struct list_elem* e;
+  int priority = PRI_MIN;
+
+  if (list_empty(&q->fifo))
+    return NULL;
+
+  r = list_entry(list_front(&q->fifo), struct block_request, elem);
+  if (r->deadline <= timer_ticks())
+    return deadline_take(q, r);
+
+  /* Take the first request at or past the head among those of
+     the highest priority, wrapping around to the lowest sector. */
+  for (e = list_begin(&q->sorted); e != list_end(&q->sorted); e = list_next(e)) {
+    r = list_entry(e, struct block_request, sort_elem);
+    if (first == NULL || r->priority > priority) {
+      priority = r->priority;
+      first = r;
+      ahead = NULL;
+    }
+    if (r->priority == priority && ahead == NULL && r->sector >= q->head)
+      ahead = r;
+  }
+  return deadline_take(q, ahead != NULL ? ahead : first);
+}
+
+static struct block_request* deadline_next_adjacent(struct block_queue* q,
+                                                    const struct block_request* prev,
+                                                    size_t max_cnt) {
+  block_sector_t end = prev->sector + prev->cnt;
+  struct list_elem* e;
+
+  for (e = list_begin(&q->sorted); e != list_end(&q->sorted); e = list_next(e)) {
+    struct block_request* r = list_entry(e, struct block_request, sort_elem);
+    if (r->sector > end)
+      break;
+    if (is_adjacent(r, prev, max_cnt))
+      return deadline_take(q, r);
+  }
+  return NULL;
+}
+
+static const struct iosched iosched_deadline = {
+    .name = "deadline",
+    .add = deadline_add,
+    .next = deadline_next,
+    .next_adjacent = deadline_next_adjacent,
+};
+
+/* All I/O schedulers. */
+static const struct iosched* const schedulers[] = {&iosched_deadline, &iosched_noop};
+
+/* Scheduler given to block devices as they are registered. */
+static const struct iosched* default_sched = &iosched_deadline;
+
+/* Returns the I/O scheduler for newly registered block devices. */
+const struct iosched* iosched_default(void) { return default_sched; }
+
+/* Makes the I/O scheduler named NAME the one for block devices
+   registered from now on.  Returns false if there is no such
+   scheduler. */
+bool iosched_select(const char* name) {
+  size_t i;
+
+  for (i = 0; i < sizeof schedulers / sizeof *schedulers; i++)
+    if (!strcmp(schedulers[i]->name, name)) {
+      default_sched = schedulers[i];
+      return true;
+    }
+  return false;
+}
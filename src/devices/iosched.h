@@ -0,0 +1,43 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* A block device's queue of requests waiting for its driver, in
+   the order chosen by an I/O scheduler.  Accessed only with
+   interrupts off. */
+struct block_queue {
+  const struct iosched* sched; /* Scheduler that orders the queue. */
+  struct list fifo;            /* Requests, oldest deadline first. */
+  struct list sorted;          /* Requests by sector (deadline only). */
+  block_sector_t head;         /* Sector just past the last dispatch. */
+};
+
+/* An I/O scheduler: a policy for the order in which a queue's
+   requests are dispatched. */
+struct iosched {
+  const char* name;
+
+  /* Adds R to Q. */
+  void (*add)(struct block_queue* q, struct block_request* r);
+
+  /* Removes and returns the request to dispatch next, or a null
+     pointer if Q is empty. */
+  struct block_request* (*next)(struct block_queue* q);
+
+  /* Removes and returns a request of no more than MAX_CNT
+     sectors that starts where PREV, just dispatched, ends and
+     transfers in the same direction, so that the driver can merge
+     them into one command.  Returns a null pointer if there is
+     none. */
+  struct block_request* (*next_adjacent)(struct block_queue* q, const struct block_request* prev,
+                                         size_t max_cnt);
+};
+
+void block_queue_init(struct block_queue*, const struct iosched*);
+const struct iosched* iosched_default(void);
+bool iosched_select(const char* name);
+
+#endif /* devices/iosched.h */
@@ -269,19 +269,20 @@ static const char* partition_type_name(uint8_t type) {
   return type_names[type] != NULL ? type_names[type] : "Unknown";
 }
 
-/* Reads sector SECTOR from partition P into BUFFER, which must
-   have room for BLOCK_SECTOR_SIZE bytes. */
-static void partition_read(void* p_, block_sector_t sector, void* buffer) {
+/* Passes request R for partition P on to the disk that P is
+   part of. */
+static void partition_submit(void* p_, struct block_request* r) {
   struct partition* p = p_;
-  block_read(p->block, p->start + sector, buffer);
+  r->sector += p->start;
+  block_forward(p->block, r);
 }
 
-/* Write sector SECTOR to partition P from BUFFER, which must
-   contain BLOCK_SECTOR_SIZE bytes.  Returns after the block has
-   acknowledged receiving the data. */
-static void partition_write(void* p_, block_sector_t sector, const void* buffer) {
+/* Flushes the write cache of the disk that partition P is part
+   of. */
+static void partition_flush(void* p_) {
   struct partition* p = p_;
-  block_write(p->block, p->start + sector, buffer);
+  block_flush(p->block);
 }
 
-static struct block_operations partition_operations = {partition_read, partition_write};
+static struct block_operations partition_operations = {.submit = partition_submit,
+                                                       .flush = partition_flush};
@@ -0,0 +1,150 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* The code in this file reads and writes PCI configuration space
+   through configuration mechanism #1, which every PC chipset
+   that Pintos runs on supports.  See [PCI] for details. */
+
+/* Configuration mechanism #1 I/O ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8 /* Selects a configuration register. */
+#define PCI_CONFIG_DATA 0xcfc    /* Reads or writes the selected register. */
+
+#define PCI_BUS_CNT 256      /* Buses per system. */
+#define PCI_SLOT_CNT 32      /* Devices per bus. */
+#define PCI_FUNC_CNT 8       /* Functions per device. */
+#define PCI_NO_VENDOR 0xffff /* Vendor ID read back from an empty slot. */
+
+/* Returns the value for PCI_CONFIG_ADDRESS that selects REG of
+   the function at BUS, SLOT, FUNC. */
+static uint32_t config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t reg) {
+  return 0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | (reg & 0xfc);
+}
+
+/* Reads the 32-bit configuration register REG of the function at
+   BUS, SLOT, FUNC. */
+static uint32_t read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t reg) {
+  outl(PCI_CONFIG_ADDRESS, config_address(bus, slot, func, reg));
+  return inl(PCI_CONFIG_DATA);
+}
+
+/* Searches every bus for a function for which MATCH, given the
+   function's ID register ID, class register CLASS_REG, and AUX,
+   returns true.  On success, fills in *DEV for the first one
+   found and returns true.  Returns false if there is none,
+   including on machines without a PCI bus. */
+static bool find_function(bool (*match)(uint32_t id, uint32_t class_reg, void* aux), void* aux,
+                          struct pci_dev* dev) {
+  int bus, slot, func;
+
+  for (bus = 0; bus < PCI_BUS_CNT; bus++)
+    for (slot = 0; slot < PCI_SLOT_CNT; slot++)
+      for (func = 0; func < PCI_FUNC_CNT; func++) {
+        uint32_t id = read_config(bus, slot, func, PCI_REG_ID);
+        uint32_t class_reg;
+
+        if ((id & 0xffff) == PCI_NO_VENDOR) {
+          if (func == 0)
+            break;
+          continue;
+        }
+
+        class_reg = read_config(bus, slot, func, PCI_REG_CLASS);
+        if (match(id, class_reg, aux)) {
+          dev->bus = bus;
+          dev->slot = slot;
+          dev->func = func;
+          dev->vendor_id = id & 0xffff;
+          dev->device_id = id >> 16;
+          dev->class = class_reg >> 24;
+          dev->subclass = (class_reg >> 16) & 0xff;
+          dev->prog_if = (class_reg >> 8) & 0xff;
+          return true;
+        }
+      }
+  return false;
+}
+
+/* Match function for pci_find_class().  AUX points to the class
+   in its upper byte and the subclass in its lower byte. */
+static bool match_class(uint32_t id UNUSED, uint32_t class_reg, void* aux) {
+  const uint16_t* class = aux;
+  return (class_reg >> 16) == *class;
+}
+
+/* Searches every bus for a function with the given CLASS and
+   SUBCLASS.  On success, fills in *DEV for the first one found
+   and returns true.  Returns false if there is none, including
+   on machines without a PCI bus. */
+bool pci_find_class(uint8_t class, uint8_t subclass, struct pci_dev* dev) {
+  uint16_t class_subclass = (class << 8) | subclass;
+  return find_function(match_class, &class_subclass, dev);
+}
+
+/* Search state for pci_find_device(). */
+struct device_search {
+  uint32_t id; /* ID register of the wanted functions. */
+  size_t skip; /* Number of matches left to skip. */
+};
+
+/* Match function for pci_find_device(). */
+static bool match_device(uint32_t id, uint32_t class_reg UNUSED, void* search_) {
+  struct device_search* search = search_;
+  return id == search->id && search->skip-- == 0;
+}
+
+/* Searches every bus for functions with the given VENDOR_ID and
+   DEVICE_ID.  If there are more than IDX of them, fills in *DEV
+   for the one that comes IDX after the first in bus order, so
+   that IDX 0 finds the first one, and returns true.  Otherwise,
+   returns false. */
+bool pci_find_device(uint16_t vendor_id, uint16_t device_id, size_t idx, struct pci_dev* dev) {
+  struct device_search search;
+
+  search.id = ((uint32_t)device_id << 16) | vendor_id;
+  search.skip = idx;
+  return find_function(match_device, &search, dev);
+}
+
+/* Returns DEV's 32-bit configuration register REG. */
+uint32_t pci_read_config(const struct pci_dev* dev, uint8_t reg) {
+  return read_config(dev->bus, dev->slot, dev->func, reg);
+}
+
+/* Sets DEV's 32-bit configuration register REG to VALUE. */
+void pci_write_config(const struct pci_dev* dev, uint8_t reg, uint32_t value) {
+  outl(PCI_CONFIG_ADDRESS, config_address(dev->bus, dev->slot, dev->func, reg));
+  outl(PCI_CONFIG_DATA, value);
+}
+
+/* Returns the I/O port base that DEV's base address register BAR
+   (0...5) decodes, or 0 if BAR is unassigned or maps memory
+   rather than I/O ports. */
+uint16_t pci_io_base(const struct pci_dev* dev, int bar) {
+  uint32_t value;
+
+  ASSERT(bar >= 0 && bar < 6);
+  value = pci_read_config(dev, PCI_REG_BAR0 + bar * 4);
+  if ((value & 1) == 0)
+    return 0;
+  return value & 0xfffc;
+}
+
+/* Returns the external interrupt line (0...15) that DEV's
+   interrupt pin is routed to, as set up by the BIOS, or -1 if it
+   is not routed. */
+int pci_interrupt_line(const struct pci_dev* dev) {
+  uint8_t line = pci_read_config(dev, PCI_REG_INTERRUPT) & 0xff;
+  return line < 16 ? line : -1;
+}
+
+/* Lets DEV access its I/O ports and master the bus, so that it
+   can perform DMA. */
+void pci_enable_bus_master(const struct pci_dev* dev) {
+  uint32_t command = pci_read_config(dev, PCI_REG_COMMAND);
+
+  /* Leave the upper half zero: its status bits are cleared by
+     writing ones. */
+  command = (command & 0xffff) | PCI_CMD_IO | PCI_CMD_BUS_MASTER;
+  pci_write_config(dev, PCI_REG_COMMAND, command);
+}
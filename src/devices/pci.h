@@ -0,0 +1,39 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A PCI function, named by its position on the bus. */
+struct pci_dev {
+  uint8_t bus;        /* Bus number. */
+  uint8_t slot;       /* Device number on the bus. */
+  uint8_t func;       /* Function number within the device. */
+  uint16_t vendor_id; /* Vendor ID. */
+  uint16_t device_id; /* Device ID. */
+  uint8_t class;      /* Base class code. */
+  uint8_t subclass;   /* Subclass code. */
+  uint8_t prog_if;    /* Programming interface. */
+};
+
+/* Offsets of configuration space registers. */
+#define PCI_REG_ID 0x00        /* Device ID 31:16, vendor ID 15:0. */
+#define PCI_REG_COMMAND 0x04   /* Status 31:16, command 15:0. */
+#define PCI_REG_CLASS 0x08     /* Class, subclass, prog IF, revision. */
+#define PCI_REG_BAR0 0x10      /* First of six base address registers. */
+#define PCI_REG_INTERRUPT 0x3c /* Interrupt pin 15:8, line 7:0. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001         /* Respond to I/O space accesses. */
+#define PCI_CMD_BUS_MASTER 0x0004 /* Allow the device to master the bus. */
+
+bool pci_find_class(uint8_t class, uint8_t subclass, struct pci_dev*);
+bool pci_find_device(uint16_t vendor_id, uint16_t device_id, size_t idx, struct pci_dev*);
+uint32_t pci_read_config(const struct pci_dev*, uint8_t reg);
+void pci_write_config(const struct pci_dev*, uint8_t reg, uint32_t value);
+uint16_t pci_io_base(const struct pci_dev*, int bar);
+int pci_interrupt_line(const struct pci_dev*);
+void pci_enable_bus_master(const struct pci_dev*);
+
+#endif /* devices/pci.h */
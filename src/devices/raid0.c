@@ -0,0 +1,166 @@
+#include "devices/raid0.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+
+/* A RAID-0 block device stripes its sectors across several
+   member devices: its first CHUNK_CNT sectors are on the first
+   member, the next CHUNK_CNT on the second, and so on, wrapping
+   around to the first member after the last.  A request that
+   spans chunks on different members is split into one request
+   per chunk, and these are all submitted before any completes,
+   so that members on different channels or devices work on them
+   at the same time. */
+
+/* Most member devices. */
+#define MEMBER_MAX 8
+
+/* The RAID-0 device. */
+struct raid0 {
+  struct block* members[MEMBER_MAX]; /* Member devices. */
+  size_t member_cnt;                 /* Number of members. */
+  size_t chunk_cnt;                  /* Sectors per chunk. */
+};
+
+/* A request on the RAID-0 device, split into per-chunk requests
+   on its members. */
+struct raid0_io {
+  struct list_elem elem;         /* Element in finished_ios. */
+  struct block_request* request; /* Request on the RAID-0 device. */
+  size_t pending;                /* Number of pieces not yet done. */
+  struct block_request pieces[]; /* Requests on members. */
+};
+
+static struct raid0 md;
+
+/* I/Os whose pieces are all done.  Done functions may run in an
+   interrupt handler, where memory cannot be freed, so the next
+   raid0_submit() frees them. */
+static struct list finished_ios = LIST_INITIALIZER(finished_ios);
+
+static struct block_operations raid0_operations;
+
+/* Creates and registers a RAID-0 device named "md0" that stripes
+   chunks of CHUNK_CNT sectors across the block devices named in
+   MEMBERS, separated by commas.  Panics if a member does not
+   exist.  Each member contributes as many whole chunks as the
+   smallest one holds. */
+void raid0_init(const char* members, size_t chunk_cnt) {
+  char names[128];
+  char *name, *save_ptr;
+  block_sector_t member_size = (block_sector_t)-1;
+  size_t i;
+
+  if (chunk_cnt == 0)
+    PANIC("md0: chunk size must be at least one sector");
+
+  strlcpy(names, members, sizeof names);
+  for (name = strtok_r(names, ",", &save_ptr); name != NULL;
+       name = strtok_r(NULL, ",", &save_ptr)) {
+    struct block* block = block_get_by_name(name);
+    if (block == NULL)
+      PANIC("md0: no such block device \"%s\"", name);
+    if (md.member_cnt >= MEMBER_MAX)
+      PANIC("md0: more than %d members", MEMBER_MAX);
+    md.members[md.member_cnt++] = block;
+    if (block_size(block) < member_size)
+      member_size = block_size(block);
+  }
+  if (md.member_cnt == 0)
+    PANIC("md0: no members");
+  md.chunk_cnt = chunk_cnt;
+
+  printf("md0: striping %zu-sector chunks across", chunk_cnt);
+  for (i = 0; i < md.member_cnt; i++)
+    printf(" %s", block_name(md.members[i]));
+  printf("\n");
+  block_register("md0", BLOCK_RAW, "RAID-0",
+                 member_size / chunk_cnt * chunk_cnt * md.member_cnt, &raid0_operations, &md);
+}
+
+/* Frees the I/Os in finished_ios. */
+static void free_finished_ios(void) {
+  for (;;) {
+    struct raid0_io* io = NULL;
+    enum intr_level old_level = intr_disable();
+    if (!list_empty(&finished_ios))
+      io = list_entry(list_pop_front(&finished_ios), struct raid0_io, elem);
+    intr_set_level(old_level);
+    if (io == NULL)
+      break;
+    free(io);
+  }
+}
+
+/* Completion function for a piece of a RAID-0 I/O.  Completes
+   the whole request once its last piece is done. */
+static void raid0_piece_done(struct block_request* piece) {
+  struct raid0_io* io = piece->aux;
+  struct block_request* r = io->request;
+  enum intr_level old_level = intr_disable();
+  bool last = --io->pending == 0;
+
+  if (last)
+    list_push_back(&finished_ios, &io->elem);
+  intr_set_level(old_level);
+  if (last)
+    block_complete(r);
+}
+
+/* Splits R into a request per chunk and submits them all to the
+   members.  Must not be called from an interrupt handler. */
+static void raid0_submit(void* md_, struct block_request* r) {
+  struct raid0* md = md_;
+  block_sector_t first_chunk = r->sector / md->chunk_cnt;
+  block_sector_t last_chunk = (r->sector + r->cnt - 1) / md->chunk_cnt;
+  size_t piece_cnt = last_chunk - first_chunk + 1;
+  block_sector_t sector = r->sector;
+  uint8_t* buffer = r->buffer;
+  struct raid0_io* io;
+  size_t i;
+
+  ASSERT(!intr_context());
+
+  free_finished_ios();
+  io = malloc(sizeof *io + piece_cnt * sizeof *io->pieces);
+  if (io == NULL)
+    PANIC("md0: out of memory");
+  io->request = r;
+  io->pending = piece_cnt;
+
+  for (i = 0; i < piece_cnt; i++) {
+    struct block_request* piece = &io->pieces[i];
+    block_sector_t chunk = sector / md->chunk_cnt;
+    size_t ofs = sector % md->chunk_cnt;
+    size_t left = r->sector + r->cnt - sector;
+
+    piece->sector = chunk / md->member_cnt * md->chunk_cnt + ofs;
+    piece->cnt = md->chunk_cnt - ofs < left ? md->chunk_cnt - ofs : left;
+    piece->buffer = buffer;
+    piece->write = r->write;
+    piece->priority = r->priority;
+    piece->done = raid0_piece_done;
+    piece->aux = io;
+
+    sector += piece->cnt;
+    buffer += piece->cnt * BLOCK_SECTOR_SIZE;
+  }
+  for (i = 0; i < piece_cnt; i++)
+    block_submit(md->members[(first_chunk + i) % md->member_cnt], &io->pieces[i]);
+}
+
+/* Flushes the write cache of every member. */
+static void raid0_flush(void* md_) {
+  struct raid0* md = md_;
+  size_t i;
+
+  for (i = 0; i < md->member_cnt; i++)
+    block_flush(md->members[i]);
+}
+
+static struct block_operations raid0_operations = {.submit = raid0_submit,
+                                                   .flush = raid0_flush};
@@ -0,0 +1,8 @@
+#ifndef DEVICES_RAID0_H
+#define DEVICES_RAID0_H
+
+#include <stddef.h>
+
+void raid0_init(const char* members, size_t chunk_cnt);
+
+#endif /* devices/raid0.h */
@@ -0,0 +1,65 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device whose sectors are kept in kernel memory, for
+   storage that need not outlive the machine, such as swap or a
+   scratch file system.  It is much faster than an emulated disk,
+   so it also gives a baseline for the cost of the block layer
+   itself.
+
+   The sectors are stored in separately allocated pages, since a
+   large enough run of contiguous free pages may not exist. */
+
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The RAM disk's pages. */
+static uint8_t** pages;
+
+static struct block_operations ramdisk_operations;
+
+/* Returns the address of SECTOR's data. */
+static uint8_t* sector_address(block_sector_t sector) {
+  return pages[sector / SECTORS_PER_PAGE] + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE;
+}
+
+/* Creates and registers a zeroed RAM disk named "ram0" of SIZE
+   bytes, rounded up to a whole number of pages.  Does nothing if
+   SIZE is 0.  Panics if there is not enough memory. */
+void ramdisk_init(size_t size) {
+  size_t page_cnt = DIV_ROUND_UP(size, PGSIZE);
+  size_t i;
+
+  if (page_cnt == 0)
+    return;
+
+  pages = malloc(page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC("ram0: out of memory");
+  for (i = 0; i < page_cnt; i++) {
+    pages[i] = palloc_get_page(PAL_ZERO);
+    if (pages[i] == NULL)
+      PANIC("ram0: out of memory after %zu of %zu pages", i, page_cnt);
+  }
+
+  block_register("ram0", BLOCK_RAW, "RAM disk", page_cnt * SECTORS_PER_PAGE, &ramdisk_operations,
+                 NULL);
+}
+
+/* Reads SECTOR into BUFFER. */
+static void ramdisk_read(void* aux UNUSED, block_sector_t sector, void* buffer) {
+  memcpy(buffer, sector_address(sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SECTOR from BUFFER. */
+static void ramdisk_write(void* aux UNUSED, block_sector_t sector, const void* buffer) {
+  memcpy(sector_address(sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations = {.read = ramdisk_read,
+                                                     .write = ramdisk_write};
@@ -24,8 +24,13 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of time stamp counter increments per microsecond.
+   Initialized by timer_calibrate(). */
+static uint64_t tsc_per_usec;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
+static uint64_t rdtsc(void);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
@@ -37,9 +42,12 @@ void timer_init(void) {
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and tsc_per_usec, used to time short intervals. */
 void timer_calibrate(void) {
   unsigned high_bit, test_bit;
+  int64_t start;
+  uint64_t tsc;
 
   ASSERT(intr_get_level() == INTR_ON);
   printf("Calibrating timer...  ");
@@ -59,6 +67,18 @@ void timer_calibrate(void) {
       loops_per_tick |= test_bit;
 
   printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+
+  /* Count time stamp counter increments over one whole tick. */
+  start = timer_ticks();
+  while (timer_ticks() == start)
+    barrier();
+  tsc = rdtsc();
+  start = timer_ticks();
+  while (timer_ticks() == start)
+    barrier();
+  tsc_per_usec = (rdtsc() - tsc) * TIMER_FREQ / (1000 * 1000);
+  if (tsc_per_usec == 0)
+    tsc_per_usec = 1;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -73,6 +93,16 @@ int64_t timer_ticks(void) {
    should be a value once returned by timer_ticks(). */
 int64_t timer_elapsed(int64_t then) { return timer_ticks() - then; }
 
+/* Returns a count of microseconds since an arbitrary point, for
+   timing intervals shorter than a timer tick.  Before
+   timer_calibrate() runs, the count advances only once per
+   tick. */
+int64_t timer_usec(void) {
+  if (tsc_per_usec == 0)
+    return timer_ticks() * (1000 * 1000 / TIMER_FREQ);
+  return rdtsc() / tsc_per_usec;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void timer_sleep(int64_t ticks) {
@@ -131,6 +161,14 @@ static void timer_interrupt(struct intr_frame* args UNUSED) {
   thread_tick();
 }
 
+/* Returns the CPU's time stamp counter, which counts clock
+   cycles or a fixed fraction of them. */
+static uint64_t rdtsc(void) {
+  uint64_t tsc;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool too_many_loops(unsigned loops) {
@@ -0,0 +1,392 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file is a driver for virtio block devices,
+   the paravirtual disks that QEMU offers with "-drive if=virtio",
+   through the legacy PCI interface of [VIRTIO] section 4.1.
+
+   The driver shares a ring of descriptors, the virtqueue, with
+   the device.  Each request is a chain of three descriptors: a
+   header that names the operation and sector, the data buffer,
+   and a status byte that the device writes when it is done.  As
+   long as there are free descriptors, requests move straight
+   from the block layer's queue to the virtqueue, so the device
+   can work on many of them at once, and the interrupt handler
+   completes them and refills the virtqueue.  No thread is
+   needed. */
+
+/* PCI IDs of a (transitional) virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Legacy virtio I/O port addresses, relative to BAR 0. */
+#define reg_features(D) ((D)->io_base + 0x00)       /* Device features. */
+#define reg_guest_features(D) ((D)->io_base + 0x04) /* Driver features. */
+#define reg_queue_pfn(D) ((D)->io_base + 0x08)      /* Queue page number. */
+#define reg_queue_size(D) ((D)->io_base + 0x0c)     /* Queue size. */
+#define reg_queue_select(D) ((D)->io_base + 0x0e)   /* Queue select. */
+#define reg_queue_notify(D) ((D)->io_base + 0x10)   /* Queue notify. */
+#define reg_status(D) ((D)->io_base + 0x12)         /* Device status. */
+#define reg_isr(D) ((D)->io_base + 0x13)            /* ISR status, cleared by reading. */
+#define reg_capacity(D) ((D)->io_base + 0x14)       /* Capacity in sectors, 64 bits. */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has noticed the device. */
+#define STATUS_DRIVER 0x02      /* Guest has a driver for it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up on the device. */
+
+/* ISR status bits. */
+#define ISR_QUEUE 0x01 /* A virtqueue has new used buffers. */
+
+/* A descriptor of one physically contiguous buffer. */
+struct vring_desc {
+  uint64_t addr;  /* Physical address. */
+  uint32_t len;   /* Length in bytes. */
+  uint16_t flags; /* VRING_DESC_F_*. */
+  uint16_t next;  /* Next descriptor in chain, if VRING_DESC_F_NEXT. */
+};
+
+#define VRING_DESC_F_NEXT 1  /* Chain continues in NEXT. */
+#define VRING_DESC_F_WRITE 2 /* Device writes, rather than reads, the buffer. */
+
+/* Ring of descriptor chains offered to the device. */
+struct vring_avail {
+  uint16_t flags;  /* Unused. */
+  uint16_t idx;    /* Where the driver puts the next entry, mod size. */
+  uint16_t ring[]; /* Heads of chains. */
+};
+
+/* One descriptor chain that the device is done with. */
+struct vring_used_elem {
+  uint32_t id;  /* Head of the chain. */
+  uint32_t len; /* Bytes the device wrote. */
+};
+
+/* Ring of descriptor chains returned by the device. */
+struct vring_used {
+  uint16_t flags;                /* Unused. */
+  uint16_t idx;                  /* Where the device puts the next entry, mod size. */
+  struct vring_used_elem ring[]; /* Chains used. */
+};
+
+/* The used ring starts at a multiple of this in legacy virtio,
+   and the whole virtqueue at a multiple of the page size. */
+#define VRING_ALIGN 4096
+
+/* Header of a block request. */
+struct virtio_blk_req {
+  uint32_t type;     /* VIRTIO_BLK_T_*. */
+  uint32_t reserved; /* Zero. */
+  uint64_t sector;   /* First sector. */
+};
+
+#define VIRTIO_BLK_T_IN 0  /* Read. */
+#define VIRTIO_BLK_T_OUT 1 /* Write. */
+
+#define VIRTIO_BLK_S_OK 0 /* Status of a request that succeeded. */
+
+/* Descriptors that one request takes. */
+#define REQ_DESC_CNT 3
+
+/* Per-request state, indexed by the request's head descriptor.
+   HEADER and STATUS are read and written by the device. */
+struct slot {
+  struct virtio_blk_req header;  /* Request header. */
+  uint8_t status;                /* Request status. */
+  struct block_request* request; /* Block request, or null if free. */
+};
+
+/* A virtio block device. */
+struct virtio_blk {
+  char name[8];        /* Name, e.g. "vda". */
+  uint16_t io_base;    /* Base I/O port. */
+  uint8_t irq;         /* Interrupt in use. */
+  struct block* block; /* Block device, once registered. */
+
+  /* Virtqueue, accessed only with interrupts off. */
+  uint16_t queue_size;       /* Number of descriptors. */
+  struct vring_desc* desc;   /* Descriptor table. */
+  struct vring_avail* avail; /* Available ring. */
+  struct vring_used* used;   /* Used ring. */
+  struct slot* slots;        /* QUEUE_SIZE request slots. */
+  uint16_t free_head;        /* First free descriptor. */
+  uint16_t free_cnt;         /* Number of free descriptors. */
+  uint16_t used_idx;         /* Next used ring entry to process. */
+};
+
+/* We support up to this many virtio block devices. */
+#define VIRTIO_BLK_CNT 4
+static struct virtio_blk disks[VIRTIO_BLK_CNT];
+static size_t disk_cnt;
+
+static struct block_operations virtio_blk_operations;
+
+static bool init_device(struct virtio_blk*, const struct pci_dev*, block_sector_t* capacity);
+static bool init_queue(struct virtio_blk*);
+static void fill_queue(struct virtio_blk*);
+static void complete_requests(struct virtio_blk*);
+static void interrupt_handler(struct intr_frame*);
+
+/* Finds and registers all the virtio block devices. */
+void virtio_blk_init(void) {
+  struct pci_dev dev;
+  size_t idx;
+
+  for (idx = 0; disk_cnt < VIRTIO_BLK_CNT
+                && pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, idx, &dev);
+       idx++) {
+    struct virtio_blk* d = &disks[disk_cnt];
+    block_sector_t capacity;
+    size_t i;
+
+    snprintf(d->name, sizeof d->name, "vd%c", (int)('a' + disk_cnt));
+    if (!init_device(d, &dev, &capacity))
+      continue;
+    disk_cnt++;
+
+    /* Devices may share an interrupt line, so register the
+       handler, which serves every device on its line, once. */
+    for (i = 0; disks[i].irq != d->irq; i++)
+      continue;
+    if (&disks[i] == d)
+      intr_register_ext(d->irq, interrupt_handler, "virtio-blk");
+
+    d->block = block_register(d->name, BLOCK_RAW, "virtio", capacity, &virtio_blk_operations, d);
+    partition_scan(d->block);
+  }
+}
+
+/* Resets and sets up the virtio block device DEV as disk D, and
+   stores its size in *CAPACITY.  Returns false, leaving the
+   device marked failed, if it cannot be used. */
+static bool init_device(struct virtio_blk* d, const struct pci_dev* dev,
+                        block_sector_t* capacity) {
+  int line = pci_interrupt_line(dev);
+  uint32_t capacity_lo, capacity_hi;
+
+  d->io_base = pci_io_base(dev, 0);
+  if (d->io_base == 0 || line < 0) {
+    printf("%s: no I/O ports or interrupt line, ignoring device\n", d->name);
+    return false;
+  }
+  d->irq = line + 0x20;
+  d->block = NULL;
+  pci_enable_bus_master(dev);
+
+  /* Reset the device and tell it that we know how to drive it.
+     We need none of its optional features. */
+  outb(reg_status(d), 0);
+  outb(reg_status(d), STATUS_ACKNOWLEDGE);
+  outb(reg_status(d), STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  inl(reg_features(d));
+  outl(reg_guest_features(d), 0);
+
+  if (!init_queue(d)) {
+    printf("%s: cannot set up virtqueue, ignoring device\n", d->name);
+    outb(reg_status(d), STATUS_FAILED);
+    return false;
+  }
+
+  /* Sectors past the reach of a block_sector_t are unusable. */
+  capacity_lo = inl(reg_capacity(d));
+  capacity_hi = inl(reg_capacity(d) + 4);
+  *capacity = capacity_hi != 0 ? (block_sector_t)-1 : capacity_lo;
+
+  outb(reg_status(d), STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+}
+
+/* Allocates disk D's virtqueue, in the size the device asks for,
+   and tells the device where it is.  Returns false if memory is
+   short or the device has no virtqueue. */
+static bool init_queue(struct virtio_blk* d) {
+  size_t avail_ofs, used_ofs, page_cnt;
+  uint8_t* queue;
+  uint16_t i;
+
+  outw(reg_queue_select(d), 0);
+  d->queue_size = inw(reg_queue_size(d));
+  if (d->queue_size == 0)
+    return false;
+
+  /* The descriptor table comes first, then the available ring,
+     then the used ring at the next VRING_ALIGN boundary.  Kernel
+     pages are physically contiguous, as the device needs. */
+  avail_ofs = d->queue_size * sizeof *d->desc;
+  used_ofs = ROUND_UP(avail_ofs + sizeof *d->avail + (d->queue_size + 1) * sizeof(uint16_t),
+                      VRING_ALIGN);
+  page_cnt = DIV_ROUND_UP(used_ofs + sizeof *d->used + d->queue_size * sizeof *d->used->ring
+                              + sizeof(uint16_t),
+                          PGSIZE);
+  queue = palloc_get_multiple(PAL_ZERO, page_cnt);
+  d->slots = calloc(d->queue_size, sizeof *d->slots);
+  if (queue == NULL || d->slots == NULL) {
+    palloc_free_multiple(queue, page_cnt);
+    free(d->slots);
+    return false;
+  }
+  d->desc = (struct vring_desc*)queue;
+  d->avail = (struct vring_avail*)(queue + avail_ofs);
+  d->used = (struct vring_used*)(queue + used_ofs);
+
+  /* Chain all the descriptors into the free list. */
+  for (i = 0; i < d->queue_size; i++)
+    d->desc[i].next = i + 1;
+  d->free_head = 0;
+  d->free_cnt = d->queue_size;
+  d->used_idx = 0;
+
+  /* The legacy interface takes the queue's page number. */
+  outl(reg_queue_pfn(d), vtop(queue) / VRING_ALIGN);
+  return true;
+}
+
+/* Takes a descriptor off disk D's free list and returns its
+   index. */
+static uint16_t alloc_desc(struct virtio_blk* d) {
+  uint16_t idx = d->free_head;
+
+  ASSERT(d->free_cnt > 0);
+  d->free_head = d->desc[idx].next;
+  d->free_cnt--;
+  return idx;
+}
+
+/* Puts the chain of descriptors starting at HEAD back on disk D's
+   free list. */
+static void free_chain(struct virtio_blk* d, uint16_t head) {
+  for (;;) {
+    struct vring_desc* desc = &d->desc[head];
+    bool more = (desc->flags & VRING_DESC_F_NEXT) != 0;
+    uint16_t next = desc->next;
+
+    desc->next = d->free_head;
+    d->free_head = head;
+    d->free_cnt++;
+    if (!more)
+      break;
+    head = next;
+  }
+}
+
+/* Sets descriptor IDX of disk D to describe the SIZE bytes at
+   BUFFER, followed by descriptor NEXT if FLAGS includes
+   VRING_DESC_F_NEXT. */
+static void set_desc(struct virtio_blk* d, uint16_t idx, const void* buffer, size_t size,
+                     uint16_t flags, uint16_t next) {
+  d->desc[idx].addr = vtop(buffer);
+  d->desc[idx].len = size;
+  d->desc[idx].flags = flags;
+  d->desc[idx].next = next;
+}
+
+/* Moves requests from disk D's block queue to its virtqueue for
+   as long as there are requests and free descriptors, then tells
+   the device about them.  Interrupts must be off. */
+static void fill_queue(struct virtio_blk* d) {
+  bool added = false;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  while (d->free_cnt >= REQ_DESC_CNT) {
+    struct block_request* r = block_dequeue(d->block);
+    uint16_t head, data, status;
+    struct slot* slot;
+
+    if (r == NULL)
+      break;
+    head = alloc_desc(d);
+    data = alloc_desc(d);
+    status = alloc_desc(d);
+
+    slot = &d->slots[head];
+    slot->header.type = r->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    slot->header.reserved = 0;
+    slot->header.sector = r->sector;
+    slot->status = 0xff;
+    slot->request = r;
+
+    set_desc(d, head, &slot->header, sizeof slot->header, VRING_DESC_F_NEXT, data);
+    set_desc(d, data, r->buffer, r->cnt * BLOCK_SECTOR_SIZE,
+             VRING_DESC_F_NEXT | (r->write ? 0 : VRING_DESC_F_WRITE), status);
+    set_desc(d, status, &slot->status, sizeof slot->status, VRING_DESC_F_WRITE, 0);
+
+    /* The device may look at the ring entry as soon as the index
+       covers it. */
+    d->avail->ring[d->avail->idx % d->queue_size] = head;
+    barrier();
+    d->avail->idx++;
+    added = true;
+  }
+
+  if (added) {
+    barrier();
+    outw(reg_queue_notify(d), 0);
+  }
+}
+
+/* Completes the requests that disk D has finished with.
+   Interrupts must be off. */
+static void complete_requests(struct virtio_blk* d) {
+  for (;;) {
+    struct vring_used_elem* e;
+    struct block_request* r;
+    struct slot* slot;
+
+    /* Reread the index that the device advances. */
+    barrier();
+    if (d->used_idx == d->used->idx)
+      break;
+
+    e = &d->used->ring[d->used_idx % d->queue_size];
+    slot = &d->slots[e->id];
+    r = slot->request;
+    if (slot->status != VIRTIO_BLK_S_OK)
+      PANIC("%s: disk %s failed, sector=%" PRDSNu, d->name, r->write ? "write" : "read",
+            r->sector);
+
+    free_chain(d, e->id);
+    slot->request = NULL;
+    d->used_idx++;
+    block_complete(r);
+  }
+}
+
+/* Tells disk D_ that a request has been queued.  Called by the
+   block layer, possibly from an interrupt handler. */
+static void virtio_blk_kick(void* d_) {
+  struct virtio_blk* d = d_;
+  enum intr_level old_level = intr_disable();
+  fill_queue(d);
+  intr_set_level(old_level);
+}
+
+static struct block_operations virtio_blk_operations = {.kick = virtio_blk_kick};
+
+/* virtio block interrupt handler.  Serves every device on the
+   interrupt's line that has new used buffers, and refills their
+   virtqueues from the freed descriptors. */
+static void interrupt_handler(struct intr_frame* f) {
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++) {
+    struct virtio_blk* d = &disks[i];
+    if (d->irq == f->vec_no && (inb(reg_isr(d)) & ISR_QUEUE) != 0 && d->block != NULL) {
+      complete_requests(d);
+      fill_queue(d);
+    }
+  }
+}
@@ -21,7 +21,7 @@ int main(int argc, char* argv[]) {
   }
 
   /* Create and open output file. */
-  if (!create(argv[2], filesize(in_fd))) {
+  if (!create(argv[2], 0)) {
     printf("%s: create failed\n", argv[2]);
     return EXIT_FAILURE;
   }
@@ -31,16 +31,14 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  /* Copy data. */
-  for (;;) {
-    char buffer[1024];
-    int bytes_read = read(in_fd, buffer, sizeof buffer);
-    if (bytes_read == 0)
-      break;
-    if (write(out_fd, buffer, bytes_read) != bytes_read) {
-      printf("%s: write failed\n", argv[2]);
+  /* Copy data inside the kernel, without a user buffer. */
+  for (int size = filesize(in_fd); size > 0;) {
+    int bytes_copied = copy_file_range(in_fd, out_fd, size);
+    if (bytes_copied <= 0) {
+      printf("%s: copy failed\n", argv[2]);
       return EXIT_FAILURE;
     }
+    size -= bytes_copied;
   }
 
   return EXIT_SUCCESS;
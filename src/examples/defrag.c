@@ -0,0 +1,31 @@
+/* defrag.c
+
+   Moves the blocks of the files specified on the command line
+   into contiguous runs. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int main(int argc, char* argv[]) {
+  bool success = true;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    int fd = open(argv[i]);
+    int moved;
+
+    if (fd < 0) {
+      printf("%s: open failed\n", argv[i]);
+      success = false;
+      continue;
+    }
+    moved = defrag(fd);
+    if (moved < 0) {
+      printf("%s: defrag failed\n", argv[i]);
+      success = false;
+    } else
+      printf("%s: %d blocks moved\n", argv[i], moved);
+    close(fd);
+  }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 
@@ -24,7 +25,7 @@ struct dir_entry {
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool dir_create(block_sector_t sector, size_t entry_cnt) {
-  return inode_create(sector, entry_cnt * sizeof(struct dir_entry));
+  return inode_create(sector, entry_cnt * sizeof(struct dir_entry), true);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -71,7 +72,8 @@ struct inode* dir_get_inode(struct dir* dir) {
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   The caller must hold DIR's directory lock. */
 static bool lookup(const struct dir* dir, const char* name, struct dir_entry* ep, off_t* ofsp) {
   struct dir_entry e;
   size_t ofs;
@@ -100,10 +102,12 @@ bool dir_lookup(const struct dir* dir, const char* name, struct inode** inode) {
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
+  inode_lock_dir(dir->inode, RW_READER);
   if (lookup(dir, name, &e, NULL))
     *inode = inode_open(e.inode_sector);
   else
     *inode = NULL;
+  inode_unlock_dir(dir->inode, RW_READER);
 
   return *inode != NULL;
 }
@@ -126,8 +130,12 @@ bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   if (*name == '\0' || strlen(name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup(dir, name, NULL, NULL))
+  /* Hold the directory exclusively so that the name check and the
+     slot update happen atomically. */
+  inode_lock_dir(dir->inode, RW_WRITER);
+
+  /* Check that DIR has not been removed and NAME is not in use. */
+  if (inode_is_removed(dir->inode) || lookup(dir, name, NULL, NULL))
     goto done;
 
   /* Set OFS to offset of free slot.
@@ -148,23 +156,48 @@ bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+  inode_unlock_dir(dir->inode, RW_WRITER);
   return success;
 }
 
+/* Returns true if DIR holds no entries other than "." and "..".
+   The caller must hold DIR's directory lock. */
+static bool is_empty(const struct dir* dir) {
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e; ofs += sizeof e)
+    if (e.in_use && strcmp(e.name, ".") && strcmp(e.name, ".."))
+      return false;
+  return true;
+}
+
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME or if it names a directory
+   that is open elsewhere or not empty.  "." and "..", and any
+   other entry that names DIR itself, are never removed.  A
+   directory is held exclusively from the emptiness check until it
+   is marked removed, so no entry can be added to it in between,
+   and none afterward. */
 bool dir_remove(struct dir* dir, const char* name) {
   struct dir_entry e;
   struct inode* inode = NULL;
+  bool is_dir = false;
   bool success = false;
   off_t ofs;
 
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
+  /* Removing "." or ".." would lock DIR or its parent after DIR. */
+  if (!strcmp(name, ".") || !strcmp(name, ".."))
+    return false;
+
+  inode_lock_dir(dir->inode, RW_WRITER);
+
   /* Find directory entry. */
-  if (!lookup(dir, name, &e, &ofs))
+  if (!lookup(dir, name, &e, &ofs) || e.inode_sector == inode_get_inumber(dir->inode))
     goto done;
 
   /* Open inode. */
@@ -172,16 +205,31 @@ bool dir_remove(struct dir* dir, const char* name) {
   if (inode == NULL)
     goto done;
 
+  /* A directory may only be removed while nothing else has it
+     open and it is empty.  Parents are always locked before their
+     children, so taking its lock here cannot deadlock. */
+  is_dir = inode_isdir(inode);
+  if (is_dir) {
+    struct dir child = {inode, 0};
+    inode_lock_dir(inode, RW_WRITER);
+    if (inode_open_cnt(inode) != 1 || !is_empty(&child))
+      goto done_child;
+  }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at(dir->inode, &e, sizeof e, ofs) != sizeof e)
-    goto done;
+    goto done_child;
 
   /* Remove inode. */
   inode_remove(inode);
   success = true;
 
+done_child:
+  if (is_dir)
+    inode_unlock_dir(inode, RW_WRITER);
 done:
+  inode_unlock_dir(dir->inode, RW_WRITER);
   inode_close(inode);
   return success;
 }
@@ -191,15 +239,19 @@ done:
    contains no more entries. */
 bool dir_readdir(struct dir* dir, char name[NAME_MAX + 1]) {
   struct dir_entry e;
+  bool success = false;
 
+  inode_lock_dir(dir->inode, RW_READER);
   while (inode_read_at(dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
     dir->pos += sizeof e;
     if (e.in_use) {
       strlcpy(name, e.name, NAME_MAX + 1);
-      return true;
+      success = true;
+      break;
     }
   }
-  return false;
+  inode_unlock_dir(dir->inode, RW_READER);
+  return success;
 }
 
 /* Extracts a file name part from *SRCP into PART, and updates *SRCP so that the
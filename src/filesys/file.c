@@ -2,12 +2,15 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* An open file. */
 struct file {
   struct inode* inode; /* File's inode. */
   off_t pos;           /* Current position. */
   bool deny_write;     /* Has file_deny_write() been called? */
+  bool direct;         /* Bypass the buffer cache for whole sectors? */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -19,6 +22,7 @@ struct file* file_open(struct inode* inode) {
     file->inode = inode;
     file->pos = 0;
     file->deny_write = false;
+    file->direct = false;
     return file;
   } else {
     inode_close(inode);
@@ -47,13 +51,38 @@ struct inode* file_get_inode(struct file* file) {
   return file->inode;
 }
 
+/* Sets whether reads and writes of whole sectors through FILE
+   bypass the buffer cache.  Other files open on the same inode
+   are unaffected and stay coherent with FILE. */
+void file_set_direct(struct file* file, bool direct) {
+  ASSERT(file != NULL);
+  file->direct = direct;
+}
+
+/* Reads SIZE bytes from FILE's inode into BUFFER at OFS, bypassing the
+   buffer cache if FILE was opened for direct I/O. */
+static off_t file_read_inode(struct file* file, void* buffer, off_t size, off_t ofs) {
+  if (file->direct)
+    return inode_read_at_direct(file->inode, buffer, size, ofs);
+  return inode_read_at(file->inode, buffer, size, ofs);
+}
+
+/* Writes SIZE bytes from BUFFER into FILE's inode at OFS,
+   bypassing the buffer cache if FILE was opened for direct
+   I/O. */
+static off_t file_write_inode(struct file* file, const void* buffer, off_t size, off_t ofs) {
+  if (file->direct)
+    return inode_write_at_direct(file->inode, buffer, size, ofs);
+  return inode_write_at(file->inode, buffer, size, ofs);
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
    Advances FILE's position by the number of bytes read. */
 off_t file_read(struct file* file, void* buffer, off_t size) {
-  off_t bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_inode(file, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -64,7 +93,7 @@ off_t file_read(struct file* file, void* buffer, off_t size) {
    which may be less than SIZE if end of file is reached.
    The file's current position is unaffected. */
 off_t file_read_at(struct file* file, void* buffer, off_t size, off_t file_ofs) {
-  return inode_read_at(file->inode, buffer, size, file_ofs);
+  return file_read_inode(file, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -75,7 +104,7 @@ off_t file_read_at(struct file* file, void* buffer, off_t size, off_t file_ofs)
    not yet implemented.)
    Advances FILE's position by the number of bytes read. */
 off_t file_write(struct file* file, const void* buffer, off_t size) {
-  off_t bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_inode(file, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -88,7 +117,37 @@ off_t file_write(struct file* file, const void* buffer, off_t size) {
    not yet implemented.)
    The file's current position is unaffected. */
 off_t file_write_at(struct file* file, const void* buffer, off_t size, off_t file_ofs) {
-  return inode_write_at(file->inode, buffer, size, file_ofs);
+  return file_write_inode(file, buffer, size, file_ofs);
+}
+
+/* Copies up to SIZE bytes from IN, starting at its current
+   position, to OUT at its current position, a page at a time
+   through a kernel buffer.  The data passes through the buffer
+   cache but never through user memory.  Returns the number of
+   bytes copied, which is less than SIZE if IN reaches end of
+   file, OUT cannot be written, or memory runs out.  Advances
+   both files' positions by that number. */
+off_t file_copy(struct file* out, struct file* in, off_t size) {
+  uint8_t* bounce = palloc_get_page(0);
+  off_t bytes_copied = 0;
+
+  if (bounce == NULL)
+    return 0;
+  while (size > 0) {
+    off_t chunk_size = size < PGSIZE ? size : PGSIZE;
+    off_t bytes_read = file_read(in, bounce, chunk_size);
+    off_t bytes_written = file_write(out, bounce, bytes_read);
+
+    /* Leave IN just past the last byte that made it to OUT. */
+    in->pos -= bytes_read - bytes_written;
+    bytes_copied += bytes_written;
+    size -= bytes_written;
+    if (bytes_written < chunk_size)
+      break;
+  }
+  palloc_free_page(bounce);
+
+  return bytes_copied;
 }
 
 /* Prevents write operations on FILE's underlying inode
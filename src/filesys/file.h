@@ -1,6 +1,7 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
@@ -10,12 +11,14 @@ struct file* file_open(struct inode*);
 struct file* file_reopen(struct file*);
 void file_close(struct file*);
 struct inode* file_get_inode(struct file*);
+void file_set_direct(struct file*, bool direct);
 
 /* Reading and writing. */
 off_t file_read(struct file*, void*, off_t);
 off_t file_read_at(struct file*, void*, off_t size, off_t start);
 off_t file_write(struct file*, const void*, off_t);
 off_t file_write_at(struct file*, const void*, off_t size, off_t start);
+off_t file_copy(struct file* out, struct file* in, off_t size);
 
 /* Preventing writes. */
 void file_deny_write(struct file*);
@@ -6,12 +6,31 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 
 /* Partition that contains the file system. */
 struct block* fs_device;
 
+/* A file system mounted at an absolute path.  Mounts are set up
+   during startup only, so the table needs no lock.  Files of a
+   mounted file system are reached through any name that leads to
+   the mount point, absolute or relative, as find_mount()
+   describes.  The mount point does not appear in directory
+   listings, and it cannot be made a directory of the disk file
+   system or the current directory. */
+#define MOUNT_MAX 4
+#define MOUNT_PATH_MAX 64
+struct mount {
+  char path[MOUNT_PATH_MAX + 1];      /* Mount point, without a trailing slash. */
+  const struct mount_operations* ops; /* File system operations. */
+  void* aux;                          /* Passed to OPS. */
+};
+static struct mount mounts[MOUNT_MAX];
+static size_t mount_cnt;
+
 static void do_format(void);
 
 /* Initializes the file system module.
@@ -26,10 +45,14 @@ void filesys_init(bool format) {
 
   inode_init();
   free_map_init();
+  journal_init();
 
   if (format)
     do_format();
 
+  /* Replay committed metadata updates before anything reads the
+     file system. */
+  journal_open();
   free_map_open();
 
   /* Initialize root directory. */
@@ -42,6 +65,9 @@ void filesys_init(bool format) {
     dir_close(root_dir);
   }
 
+  /* Temporary files live in memory only. */
+  tmpfs_init("/tmp");
+
   /* Open root directory as CWD for current working directory */
   struct process* pcb = thread_current()->pcb;
   pcb->cwd = dir_open_root();
@@ -50,10 +76,120 @@ void filesys_init(bool format) {
 /* Shuts down the file system module, writing any unwritten data
    to disk. */
 void filesys_done(void) {
+  journal_close();
   buffer_cache_done();
+  block_flush(fs_device);
   free_map_close();
 }
 
+/* Mounts a file system served by OPS, passing AUX, at PATH, an
+   absolute path such as "/bin".  Returns true if successful,
+   false if PATH is invalid or the mount table is full. */
+bool filesys_mount(const char* path, const struct mount_operations* ops, void* aux) {
+  size_t len = strlen(path);
+  if (path[0] != '/' || len < 2 || len > MOUNT_PATH_MAX || path[len - 1] == '/' ||
+      mount_cnt >= MOUNT_MAX)
+    return false;
+
+  struct mount* m = &mounts[mount_cnt++];
+  strlcpy(m->path, path, sizeof m->path);
+  m->ops = ops;
+  m->aux = aux;
+  return true;
+}
+
+/* Returns true if PART is one of the slash-separated components
+   of NAME. */
+static bool has_part(const char* name, const char* part) {
+  size_t len = strlen(part);
+  for (const char* p = name; (p = strstr(p, part)) != NULL; p++)
+    if ((p == name || p[-1] == '/') && (p[len] == '/' || p[len] == '\0'))
+      return true;
+  return false;
+}
+
+/* Returns the mount whose mount point is the entry named PART of
+   directory DIR, or a null pointer if there is none. */
+static struct mount* mount_at(struct inode* dir, const char* part) {
+  for (size_t i = 0; i < mount_cnt; i++) {
+    struct mount* m = &mounts[i];
+    const char* last = strrchr(m->path, '/') + 1;
+    if (strcmp(last, part))
+      continue;
+
+    char parent[MOUNT_PATH_MAX + 1];
+    strlcpy(parent, m->path, last - m->path + 1);
+    struct inode* inode = dir_resolve_path(parent);
+    bool match = inode != NULL && inode_get_inumber(inode) == inode_get_inumber(dir);
+    inode_close(inode);
+    if (match)
+      return m;
+  }
+  return NULL;
+}
+
+/* Returns the mount that NAME lies under and stores NAME's path
+   relative to the mount point in *REST, which is empty if NAME
+   names the mount point itself.  Returns a null pointer if NAME
+   lies under no mount point.  NAME is followed through the disk
+   file system as far as the mount point, so that relative names,
+   ".", ".." and repeated slashes lead to a mount point just as
+   they lead to a directory.  "." and ".." directly below the
+   mount point are understood too; the rest of NAME, from its
+   first other component on, is up to the mounted file system.
+   Names that mention no mount point by name are not followed. */
+static struct mount* find_mount(const char* name, const char** rest) {
+  bool mentioned = false;
+  for (size_t i = 0; i < mount_cnt && !mentioned; i++)
+    mentioned = has_part(name, strrchr(mounts[i].path, '/') + 1);
+  if (!mentioned)
+    return NULL;
+
+  struct inode* dir;
+  if (name[0] == '/')
+    dir = inode_open(ROOT_DIR_SECTOR);
+  else
+    dir = inode_reopen(dir_get_inode(thread_current()->pcb->cwd));
+
+  struct mount* m = NULL;
+  char part[NAME_MAX + 1];
+  for (const char* p = name; dir != NULL;) {
+    while (*p == '/')
+      p++;
+    const char* start = p;
+    int result = dir_get_next_part(part, &p);
+    if (m != NULL) {
+      if (result > 0 && !strcmp(part, "."))
+        continue;
+      if (result > 0 && !strcmp(part, "..")) { /* Back in the mount point's parent, DIR. */
+        m = NULL;
+        continue;
+      }
+      *rest = start;
+      break;
+    }
+    if (result <= 0 || !inode_isdir(dir))
+      break;
+
+    m = mount_at(dir, part);
+    if (m == NULL) {
+      struct dir* d = dir_open(dir);
+      dir = NULL;
+      if (d != NULL)
+        dir_lookup(d, part, &dir);
+      dir_close(d);
+    }
+  }
+  inode_close(dir);
+  return m;
+}
+
+/* Returns true if NAME names a mount point or a file below one. */
+bool filesys_in_mount(const char* name) {
+  const char* rest;
+  return find_mount(name, &rest) != NULL;
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
@@ -65,6 +201,11 @@ bool filesys_create(const char* name, off_t initial_size) {
   if (name == NULL || name[0] == '\0')
     return false;
 
+  const char* rest;
+  struct mount* m = find_mount(name, &rest);
+  if (m != NULL)
+    return *rest != '\0' && m->ops->create != NULL && m->ops->create(m->aux, rest, initial_size);
+
   struct dir* dir;
   bool absolute = name[0] == '/';
   char file_name[NAME_MAX + 1];
@@ -83,12 +224,25 @@ bool filesys_create(const char* name, off_t initial_size) {
     dir = dir_open(dir_resolve_path((char*)name));
   }
 
-  /* Create operation. */
-  bool success =
-      (dir != NULL && free_map_allocate(1, &inode_sector) &&
-       inode_create(inode_sector, initial_size) && dir_add(dir, file_name, inode_sector));
+  /* Create operation.  The file is created empty and then grown,
+     since growing it may take more than one transaction. */
+  journal_begin();
+  bool success = (dir != NULL && free_map_allocate(1, &inode_sector) &&
+                  inode_create(inode_sector, 0, false) && dir_add(dir, file_name, inode_sector));
   if (!success && inode_sector != 0)
     free_map_release(inode_sector, 1);
+  journal_end();
+
+  if (success && initial_size > 0) {
+    struct inode* inode = inode_open(inode_sector);
+    success = inode != NULL && inode_truncate(inode, initial_size);
+    if (!success) {
+      journal_begin();
+      dir_remove(dir, file_name);
+      journal_end();
+    }
+    inode_close(inode);
+  }
   dir_close(dir);
 
   return success;
@@ -104,6 +258,11 @@ struct file* filesys_open(const char* name) {
   bool absolute = name[0] == '/';
   char file_name[NAME_MAX + 1];
 
+  const char* rest;
+  struct mount* m = find_mount(name, &rest);
+  if (m != NULL)
+    return *rest != '\0' ? file_open(m->ops->open(m->aux, rest)) : NULL;
+
   int num_parts = dir_file_path_num_parts((char*)name);
   if (num_parts == 0) {
     if (!strcmp(name, "/"))
@@ -137,6 +296,12 @@ bool filesys_remove(const char* name) {
   struct dir* dir;
   bool absolute = name[0] == '/';
   char file_name[NAME_MAX + 1];
+
+  const char* rest;
+  struct mount* m = find_mount(name, &rest);
+  if (m != NULL)
+    return *rest != '\0' && m->ops->remove != NULL && m->ops->remove(m->aux, rest);
+
   int num_parts = dir_file_path_num_parts((char*)name);
   if (num_parts == 0) {
     return false;
@@ -152,36 +317,10 @@ bool filesys_remove(const char* name) {
     dir = dir_open(dir_resolve_path((char*)name));
   }
 
-  /* Check if file being removed is directory. */
-  struct inode* inode;
-  if (dir_lookup(dir, file_name, &inode)) {
-    if (inode_isdir(inode)) {
-      if (inode_open_cnt(inode) != 1) { /* Directory has multiple opens, invalid remove. */
-        inode_close(inode);
-        dir_close(dir);
-        return false;
-      }
-
-      /* Check directory is empty. */
-      struct dir* remove_dir = dir_open(inode);
-      char remove_dir_entry[NAME_MAX + 1];
-      while (dir_readdir(remove_dir, remove_dir_entry)) {
-        if (strcmp(remove_dir_entry, ".") != 0 &&
-            strcmp(remove_dir_entry, "..") != 0) { /* Non-empty. */
-          dir_close(remove_dir);
-          dir_close(dir);
-          return false;
-        }
-      }
-
-      dir_close(remove_dir);
-    } else {
-      inode_close(inode);
-    }
-  }
-
+  journal_begin();
   bool success = dir != NULL && dir_remove(dir, file_name);
   dir_close(dir);
+  journal_end();
 
   return success;
 }
@@ -190,6 +329,7 @@ bool filesys_remove(const char* name) {
 static void do_format(void) {
   printf("Formatting file system...");
   free_map_create();
+  journal_create();
   if (!dir_create(ROOT_DIR_SECTOR, 16))
     PANIC("root directory creation failed");
   free_map_close();
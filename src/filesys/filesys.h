@@ -7,14 +7,29 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0 /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1 /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2  /* Metadata journal header sector. */
 
 /* Block device that contains the file system. */
 extern struct block* fs_device;
 
+struct inode;
+
+/* Operations of a file system mounted into the namespace of the
+   disk file system.  NAME is relative to the mount point and AUX
+   is the value passed to filesys_mount().  CREATE and REMOVE may
+   be null for read-only file systems. */
+struct mount_operations {
+  struct inode* (*open)(void* aux, const char* name);
+  bool (*create)(void* aux, const char* name, off_t initial_size);
+  bool (*remove)(void* aux, const char* name);
+};
+
 void filesys_init(bool format);
 void filesys_done(void);
 bool filesys_create(const char* name, off_t initial_size);
 struct file* filesys_open(const char* name);
 bool filesys_remove(const char* name);
+bool filesys_mount(const char* path, const struct mount_operations*, void* aux);
+bool filesys_in_mount(const char* name);
 
 #endif /* filesys/filesys.h */
@@ -4,12 +4,16 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/synch.h"
 
 static struct file* free_map_file; /* Free map file. */
 static struct bitmap* free_map;    /* Free map, one bit per sector. */
 static struct lock free_map_lock;  /* Lock to synchronize the free map. */
 
+/* Number of free map bits stored in one sector of its file. */
+#define FREE_MAP_SECTOR_BITS (BLOCK_SECTOR_SIZE * 8)
+
 /* Initializes the free map. */
 void free_map_init(void) {
   free_map = bitmap_create(block_size(fs_device));
@@ -17,6 +21,7 @@ void free_map_init(void) {
     PANIC("bitmap creation failed--file system device is too large");
   bitmap_mark(free_map, FREE_MAP_SECTOR);
   bitmap_mark(free_map, ROOT_DIR_SECTOR);
+  bitmap_mark(free_map, JOURNAL_SECTOR);
   lock_init(&free_map_lock);
 }
 
@@ -24,11 +29,14 @@ void free_map_init(void) {
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
-   written. */
+   written.  Only the bytes of the free map file that hold the
+   changed bits are written, so that a transaction logs one or two
+   of its sectors however large the device is. */
 bool free_map_allocate(size_t cnt, block_sector_t* sectorp) {
   lock_acquire(&free_map_lock);
   block_sector_t sector = bitmap_scan_and_flip(free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR && free_map_file != NULL && !bitmap_write(free_map, free_map_file)) {
+  if (sector != BITMAP_ERROR && free_map_file != NULL &&
+      !bitmap_write_range(free_map, free_map_file, sector, cnt)) {
     bitmap_set_multiple(free_map, sector, cnt, false);
     sector = BITMAP_ERROR;
   }
@@ -38,15 +46,70 @@ bool free_map_allocate(size_t cnt, block_sector_t* sectorp) {
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Returns SECTOR to the free map at once.  Free map lock must be
+   held. */
+static void release_sector(block_sector_t sector) {
+  ASSERT(bitmap_test(free_map, sector));
+  bitmap_reset(free_map, sector);
+  bitmap_write_range(free_map, free_map_file, sector, 1);
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.  Inside
+   a transaction, they only become available once its group has
+   committed, as journal_free() describes. */
 void free_map_release(block_sector_t sector, size_t cnt) {
   lock_acquire(&free_map_lock);
   ASSERT(bitmap_all(free_map, sector, cnt));
-  bitmap_set_multiple(free_map, sector, cnt, false);
-  bitmap_write(free_map, free_map_file);
+  for (size_t i = 0; i < cnt; i++)
+    if (!journal_free(sector + i))
+      release_sector(sector + i);
   lock_release(&free_map_lock);
 }
 
+/* Makes the CNT sectors in SECTORS, which need not be
+   consecutive, available for use, under one acquisition of the
+   free map lock.  Inside a transaction, they only become
+   available once its group has committed. */
+void free_map_release_multiple(const block_sector_t* sectors, size_t cnt) {
+  if (cnt == 0)
+    return;
+  lock_acquire(&free_map_lock);
+  for (size_t i = 0; i < cnt; i++)
+    if (!journal_free(sectors[i]))
+      release_sector(sectors[i]);
+  lock_release(&free_map_lock);
+}
+
+/* Returns the CNT sectors in SECTORS, whose release has committed,
+   to the free map.  Since they may be scattered all over the
+   device, this takes as many transactions as needed for none to
+   log more than JOURNAL_TXN_BLOCKS sectors of the free map file.
+   Must not be called inside a transaction. */
+void free_map_release_committed(const block_sector_t* sectors, size_t cnt) {
+  size_t i = 0;
+  while (i < cnt) {
+    block_sector_t touched[JOURNAL_TXN_BLOCKS];
+    size_t touched_cnt = 0;
+
+    journal_begin();
+    lock_acquire(&free_map_lock);
+    for (; i < cnt; i++) {
+      block_sector_t map_sector = sectors[i] / FREE_MAP_SECTOR_BITS;
+      size_t j;
+      for (j = 0; j < touched_cnt && touched[j] != map_sector; j++)
+        continue;
+      if (j == touched_cnt) {
+        if (touched_cnt == JOURNAL_TXN_BLOCKS)
+          break;
+        touched[touched_cnt++] = map_sector;
+      }
+      release_sector(sectors[i]);
+    }
+    lock_release(&free_map_lock);
+    journal_end();
+  }
+}
+
 /* Opens the free map file and reads it from disk. */
 void free_map_open(void) {
   free_map_file = file_open(inode_open(FREE_MAP_SECTOR));
@@ -63,7 +126,7 @@ void free_map_close(void) { file_close(free_map_file); }
    it. */
 void free_map_create(void) {
   /* Create inode. */
-  if (!inode_create(FREE_MAP_SECTOR, bitmap_file_size(free_map)))
+  if (!inode_create(FREE_MAP_SECTOR, bitmap_file_size(free_map), false))
     PANIC("free map creation failed");
 
   /* Write bitmap to file. */
@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -70,7 +71,7 @@ void fsutil_extract(char** argv UNUSED) {
 
   /* Allocate buffers. */
   header = malloc(BLOCK_SECTOR_SIZE);
-  data = malloc(BLOCK_SECTOR_SIZE);
+  data = palloc_get_page(0);
   if (header == NULL || data == NULL)
     PANIC("couldn't allocate buffers");
 
@@ -111,10 +112,12 @@ void fsutil_extract(char** argv UNUSED) {
       if (dst == NULL)
         PANIC("%s: open failed", file_name);
 
-      /* Do copy. */
+      /* Do copy, a page of sectors per read. */
       while (size > 0) {
-        int chunk_size = (size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size);
-        block_read(src, sector++, data);
+        int chunk_size = (size > PGSIZE ? PGSIZE : size);
+        size_t sector_cnt = DIV_ROUND_UP(chunk_size, BLOCK_SECTOR_SIZE);
+        block_read_multiple(src, sector, sector_cnt, data);
+        sector += sector_cnt;
         if (file_write(dst, data, chunk_size) != chunk_size)
           PANIC("%s: write failed with %d bytes unwritten", file_name, size);
         size -= chunk_size;
@@ -134,7 +137,7 @@ void fsutil_extract(char** argv UNUSED) {
   block_write(src, 0, header);
   block_write(src, 1, header);
 
-  free(data);
+  palloc_free_page(data);
   free(header);
 }
 
@@ -5,8 +5,12 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 #include <stdio.h>
 
 /* Identifies an inode. */
@@ -24,21 +28,72 @@ struct inode_disk {
   unsigned magic;                  /* Magic number. */
 };
 
+/* Largest file size, in bytes. */
+#define INODE_MAX_LENGTH ((INODE_NUM_DP + 128 + 128 * 128) * BLOCK_SECTOR_SIZE)
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t bytes_to_sectors(off_t size) { return DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE); }
 
+/* Blocks claimed and given up by one resize of an inode. */
+struct inode_resize {
+  struct inode* owner;      /* Dirty list for new blocks, or null. */
+  block_sector_t run_start; /* Next sector of a preallocated run. */
+  size_t run_cnt;           /* Sectors left in the run. */
+  bool run_zero;            /* Zero run sectors as they are taken? */
+  block_sector_t* released; /* Sectors to free once the resize ends. */
+  size_t released_cnt;      /* Number of sectors in RELEASED. */
+  size_t released_cap;      /* Capacity of RELEASED. */
+};
+
 /* Resizes an inode file. */
-static bool inode_file_resize(struct inode_disk* data, off_t size);
+static bool inode_file_resize(struct inode_disk* data, off_t size, struct inode* owner);
+static bool inode_resize_blocks(struct inode_disk* data, off_t size, struct inode_resize* rs);
+static void inode_resize_finish(struct inode_resize* rs);
+static bool inode_grow(struct inode* inode, off_t length, bool prealloc);
+
+/* Buffer cache helpers. */
+static void buffer_cache_clean(struct buffer_cache_entry* bce);
+static void buffer_cache_disown(struct inode* inode);
+static void buffer_cache_release_locked(struct buffer_cache_entry* bce);
+static void buffer_cache_submit(struct buffer_cache_entry* bce, bool write, int priority,
+                                struct semaphore* done);
+static void buffer_cache_read_direct(block_sector_t block_id, size_t cnt, void* buffer);
+static void buffer_cache_write_direct(block_sector_t block_id, size_t cnt, const void* buffer);
+static void buffer_cache_demote(struct buffer_cache_entry* bce);
+static void buffer_cache_demote_block(block_sector_t block_id);
+static void buffer_cache_discard(block_sector_t block_id);
+
+/* Page cache. */
+struct page_cache_entry;
+static void page_cache_init(void);
+static struct page_cache_entry* page_cache_acquire(struct inode* inode, size_t page_idx);
+static struct page_cache_entry* page_cache_prefetch(struct inode* inode, size_t page_idx);
+static void page_cache_release(struct page_cache_entry* pce);
+static void page_cache_update(struct inode* inode, const uint8_t* buffer, off_t size, off_t offset);
+static void page_cache_invalidate(block_sector_t inumber, size_t first_idx);
+static size_t page_cache_shrink(size_t page_cnt);
+static void page_cache_reset(void);
 
 /* In-memory inode. */
 struct inode {
-  struct list_elem elem; /* Element in inode list. */
-  block_sector_t sector; /* Sector number of disk location. */
-  int open_cnt;          /* Number of openers. */
-  bool removed;          /* True if deleted, false otherwise. */
-  int deny_write_cnt;    /* 0: writes ok, >0: deny writes. */
-  struct lock lock;      /* Synchronization lock. */
+  struct list_elem elem;   /* Element in inode list. */
+  block_sector_t sector;   /* Sector number of disk location. */
+  int open_cnt;            /* Number of openers. */
+  bool removed;            /* True if deleted, false otherwise. */
+  int deny_write_cnt;      /* 0: writes ok, >0: deny writes. */
+  struct lock lock;        /* Synchronization lock. */
+  struct rw_lock dir_lock; /* Readers-writers lock on directory entries. */
+  struct rw_lock map_lock; /* Shared by reads and writes, exclusive while blocks move. */
+  struct list dirty_blocks; /* Dirty cache blocks owned by this inode. */
+  bool metadata_dirty;      /* Inode sector changed since the last sync. */
+  enum inode_advice advice; /* Access pattern: normal, sequential, random or noreuse. */
+  off_t readahead_pos;      /* End of the last read-ahead window. */
+
+  /* Inodes of mounted file systems other than the one on
+     fs_device are served by OPS, given AUX, instead. */
+  const struct inode_operations* ops;
+  void* aux;
 };
 
 /* Buffer cache. */
@@ -47,16 +102,90 @@ struct buffer_cache_entry {
   block_sector_t block_id;          /* Block index. */
   bool valid;                       /* Indicate if block is valid. */
   bool dirty;                       /* Indicate if block is dirty. */
+  bool journaled;                   /* Pinned until the journal commits it. */
   int ref_cnt;                      /* Serialize block access, number of current access to block. */
   struct condition cond;            /* Condition variable to serialize block access. */
   struct list_elem elem;            /* Element of available cache list. */
+  struct inode* owner;              /* Open inode the dirty block belongs to, if any. */
+  struct list_elem dirty_elem;      /* Element of owner's dirty block list. */
+  struct block_request io;          /* Asynchronous read or write-back. */
 };
 struct buffer_cache_entry buffer_cache[64]; /* Static memory allocation of buffer cache. */
 struct lock buffer_cache_lock;              /* Synchronize updates to buffer cache. */
 struct list available_cache;                /* List of available cache blocks. */
+static struct condition buffer_cache_freed; /* Signaled when an entry may be evicted. */
 static int buffer_cache_access_cnt;         /* The number of times the buffer cache is accessed. */
 static int buffer_cache_hit_cnt; /* The number of times a hit occurs in the buffer cache. */
 
+/* Most blocks moved by one device request of a direct transfer. */
+#define DIRECT_MAX_SECTORS 64
+
+/* Page cache.  Reads of regular file data are served from whole
+   4 kB pages indexed by inode and page number, so a page costs
+   one lookup and one entry instead of eight.  Pages are never
+   dirty: writes go through the buffer cache as before, which
+   keeps the journal, fsync and direct I/O unchanged, and then
+   update any cached copy.  Pages are filled straight from disk,
+   or from the buffer cache where it has a sector, without adding
+   data sectors to the buffer cache, which is left for metadata
+   and writes.  Directories, the free map, direct reads and reads
+   advised ADVICE_NOREUSE bypass the page cache.
+
+   The cache starts with PAGE_CACHE_MIN pages and grows into free
+   kernel pages instead of evicting, up to PAGE_CACHE_MAX, but
+   never into the last PAGE_CACHE_RESERVE of them.  When other
+   allocations eat into the reserve, the next miss gives back the
+   least recently used pages until it is whole again.  Since pages
+   are clean, that needs no I/O.  Should the kernel pool still run
+   out, palloc calls page_cache_shrink() as a last resort. */
+#define PAGE_CACHE_MIN 8      /* 32 kB, as much data as the buffer cache holds. */
+#define PAGE_CACHE_MAX 1024   /* 4 MB. */
+#define PAGE_CACHE_RESERVE 64 /* Free kernel pages left to others, 256 kB. */
+#define PAGE_CACHE_BUCKETS 64 /* Hash buckets for lookups. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+struct page_cache_entry {
+  uint8_t* kpage;               /* Page of file data, or null for a spare entry. */
+  block_sector_t inumber;       /* Sector of the file's inode. */
+  size_t page_idx;              /* Page number within the file. */
+  bool valid;                   /* Holds a page of a file? */
+  bool loading;                 /* Being read in by its first user? */
+  int ref_cnt;                  /* Number of current users. */
+  struct list_elem elem;        /* Element of page_cache_lru or page_cache_spare. */
+  struct list_elem bucket_elem; /* Element of a bucket, if valid. */
+};
+static struct list page_cache_buckets[PAGE_CACHE_BUCKETS]; /* Valid entries by page. */
+static struct list page_cache_lru;       /* Entries with pages, most recently used first. */
+static struct list page_cache_spare;     /* Entries whose pages were given back. */
+static size_t page_cache_cnt;            /* Number of entries in page_cache_lru. */
+static struct lock page_cache_lock;      /* Synchronizes the page cache. */
+static struct condition page_cache_cond; /* Signaled when a page loads or is released. */
+static int page_cache_access_cnt;        /* Page lookups since the last reset. */
+static int page_cache_hit_cnt;           /* Lookups that found the page. */
+
+/* Read-ahead.  Pages queued by inode_readahead() are read into
+   the page cache by a kernel thread, so that the reader that
+   queued them need not wait.  Each request holds a reference to
+   its inode.  Requests that do not fit in the queue are dropped,
+   since they are only hints. */
+#define READAHEAD_QUEUE_SIZE 64
+
+/* Sectors read ahead of a sequential reader, and prefetched for
+   ADVICE_WILLNEED, rounded up to whole pages. */
+#define READAHEAD_SECTORS 8
+#define READAHEAD_MAX 32
+
+/* A page to read ahead. */
+struct readahead_request {
+  struct inode* inode; /* File to read, reopened for the request. */
+  size_t page_idx;     /* Page number within the file. */
+};
+
+static struct readahead_request readahead_queue[READAHEAD_QUEUE_SIZE]; /* Ring of requests. */
+static size_t readahead_head;           /* Index of the oldest request. */
+static size_t readahead_cnt;            /* Number of queued requests. */
+static struct lock readahead_lock;      /* Synchronizes the queue. */
+static struct condition readahead_cond; /* Signaled when a request arrives. */
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -146,10 +275,10 @@ void inode_init(void) {
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  IS_DIR marks the inode as a directory.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
-bool inode_create(block_sector_t sector, off_t length) {
+bool inode_create(block_sector_t sector, off_t length, bool is_dir) {
   struct inode_disk* disk_inode = NULL;
   bool success = false;
 
@@ -161,19 +290,23 @@ bool inode_create(block_sector_t sector, off_t length) {
 
   disk_inode = calloc(1, sizeof *disk_inode);
   if (disk_inode != NULL) {
+    journal_begin();
     disk_inode->length = length;
+    disk_inode->is_dir = is_dir;
     disk_inode->magic = INODE_MAGIC;
 
     /* Allocate blocks for initial file size. */
-    success = inode_file_resize(disk_inode, length);
+    success = inode_file_resize(disk_inode, length, NULL);
     if (!success)
-      inode_file_resize(disk_inode, 0);
+      inode_file_resize(disk_inode, 0, NULL);
 
     /* Write new inode disk to disk. */
     struct buffer_cache_entry* bce = buffer_cache_acquire(sector, true);
     memcpy(bce->block, disk_inode, BLOCK_SECTOR_SIZE);
+    buffer_cache_log(bce);
     buffer_cache_release(bce);
 
+    journal_end();
     free(disk_inode);
   }
 
@@ -213,11 +346,46 @@ struct inode* inode_open(block_sector_t sector) {
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->metadata_dirty = false;
+  inode->advice = ADVICE_NORMAL;
+  inode->readahead_pos = 0;
+  inode->ops = NULL;
   lock_init(&inode->lock);
+  rw_lock_init(&inode->dir_lock);
+  rw_lock_init(&inode->map_lock);
+  list_init(&inode->dirty_blocks);
 
   return inode;
 }
 
+/* Returns a new inode for a file of a mounted file system that
+   does not live on the file system device.  Reads, writes and
+   lengths are served by OPS, passing AUX, and OPS->close() is
+   called when the last opener closes it.  Unlike inode_open(),
+   every call returns a distinct inode; the file system should
+   reopen an inode it already has open instead.  Returns a null
+   pointer if memory allocation fails. */
+struct inode* inode_open_ops(const struct inode_operations* ops, void* aux) {
+  struct inode* inode = malloc(sizeof *inode);
+  if (inode == NULL)
+    return NULL;
+
+  inode->sector = INODE_NO_SECTOR;
+  inode->open_cnt = 1;
+  inode->deny_write_cnt = 0;
+  inode->removed = false;
+  inode->metadata_dirty = false;
+  inode->advice = ADVICE_NORMAL;
+  inode->readahead_pos = 0;
+  inode->ops = ops;
+  inode->aux = aux;
+  lock_init(&inode->lock);
+  rw_lock_init(&inode->dir_lock);
+  rw_lock_init(&inode->map_lock);
+  list_init(&inode->dirty_blocks);
+  return inode;
+}
+
 /* Reopens and returns INODE. */
 struct inode* inode_reopen(struct inode* inode) {
   if (inode != NULL) {
@@ -246,17 +414,25 @@ void inode_close(struct inode* inode) {
   int open_cnt = --inode->open_cnt;
   lock_release(&inode->lock);
 
-  if (open_cnt == 0) {
+  if (open_cnt == 0 && inode->ops != NULL) {
+    inode->ops->close(inode->aux);
+    free(inode);
+  } else if (open_cnt == 0) {
     /* Remove from inode list and release lock. */
     lock_acquire(&open_inodes_lock);
     list_remove(&inode->elem);
     lock_release(&open_inodes_lock);
 
+    /* Leave dirty blocks to ordinary write-back. */
+    buffer_cache_disown(inode);
+
     /* Deallocate blocks if removed. */
     lock_acquire(&inode->lock);
     bool removed = inode->removed;
     lock_release(&inode->lock);
     if (removed) {
+      journal_begin();
+
       /* Get associated inode disk from block device. */
       struct inode_disk* data = malloc(sizeof(struct inode_disk));
       struct buffer_cache_entry* bce_data = buffer_cache_acquire(inode->sector, false);
@@ -264,8 +440,12 @@ void inode_close(struct inode* inode) {
       buffer_cache_release(bce_data);
 
       /* Remove data blocks, pointer blocks, and inode disk block. */
-      inode_file_resize(data, 0);
+      page_cache_invalidate(inode->sector, 0);
+      inode_file_resize(data, 0, NULL);
       free_map_release(inode->sector, 1);
+      free(data);
+
+      journal_end();
     }
 
     free(inode);
@@ -281,12 +461,165 @@ void inode_remove(struct inode* inode) {
   lock_release(&inode->lock);
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+/* Returns true if INODE has been marked for deletion. */
+bool inode_is_removed(struct inode* inode) {
+  lock_acquire(&inode->lock);
+  bool removed = inode->removed;
+  lock_release(&inode->lock);
+  return removed;
+}
+
+/* Queues the pages of INODE's data that hold the SECTOR_CNT
+   sectors starting at byte offset POS for reading ahead into the
+   page cache, skipping those that an overlapping earlier window
+   already queued.  Directories and the free map bypass the page
+   cache, so nothing is read ahead for them. */
+static void inode_readahead(struct inode* inode, off_t pos, size_t sector_cnt) {
+  if (inode->sector == FREE_MAP_SECTOR || inode_isdir(inode))
+    return;
+
+  off_t length = inode_length(inode);
+  off_t end = pos + (off_t)sector_cnt * BLOCK_SECTOR_SIZE;
+  if (end > length)
+    end = length;
+  end = ROUND_UP(end, PGSIZE);
+
+  lock_acquire(&inode->lock);
+  off_t start = inode->readahead_pos;
+  if (start < pos || start > end)
+    start = pos;
+  if (start < end)
+    inode->readahead_pos = end;
+  lock_release(&inode->lock);
+
+  lock_acquire(&readahead_lock);
+  for (off_t ofs = ROUND_DOWN(start, PGSIZE); ofs < end; ofs += PGSIZE) {
+    if (readahead_cnt == READAHEAD_QUEUE_SIZE)
+      break;
+    struct readahead_request* rq =
+        &readahead_queue[(readahead_head + readahead_cnt++) % READAHEAD_QUEUE_SIZE];
+    rq->inode = inode_reopen(inode);
+    rq->page_idx = ofs / PGSIZE;
+  }
+  cond_signal(&readahead_cond, &readahead_lock);
+  lock_release(&readahead_lock);
+}
+
+/* Reads queued pages into the page cache, one at a time, skipping
+   those already cached or past the end of their file. */
+static void readahead_thread(void* aux UNUSED) {
+  for (;;) {
+    lock_acquire(&readahead_lock);
+    while (readahead_cnt == 0)
+      cond_wait(&readahead_cond, &readahead_lock);
+    struct readahead_request rq = readahead_queue[readahead_head];
+    readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+    readahead_cnt--;
+    lock_release(&readahead_lock);
+
+    rw_lock_acquire(&rq.inode->map_lock, true);
+    if ((off_t)rq.page_idx * PGSIZE < inode_length(rq.inode)) {
+      struct page_cache_entry* pce = page_cache_prefetch(rq.inode, rq.page_idx);
+      if (pce != NULL)
+        page_cache_release(pce);
+    }
+    rw_lock_release(&rq.inode->map_lock, true);
+    inode_close(rq.inode);
+  }
+}
+
+/* Tells the buffer cache how INODE's data will be read, starting
+   at byte offset POS:
+
+   - ADVICE_NORMAL: No particular pattern.  The default.
+
+   - ADVICE_SEQUENTIAL: Sequentially; each read queues the pages
+     holding the next READAHEAD_SECTORS sectors to be read ahead
+     into the page cache.
+
+   - ADVICE_RANDOM: Randomly; nothing is read ahead.
+
+   - ADVICE_NOREUSE: Once; sectors read are left at the cold end
+     of the replacement list, so they are evicted first.
+
+   - ADVICE_WILLNEED: Soon; the pages holding READAHEAD_MAX
+     sectors from POS are prefetched now.  The access pattern is
+     unchanged.
+
+   - ADVICE_DONTNEED: Not soon; cached sectors of the file are
+     moved to the cold end now, and its cached pages dropped.  The
+     access pattern is unchanged.
+
+   The hint applies to every opener of INODE. */
+void inode_advise(struct inode* inode, enum inode_advice advice, off_t pos) {
+  if (inode->ops != NULL)
+    return;
+
+  switch (advice) {
+    case ADVICE_WILLNEED:
+      inode_readahead(inode, pos, READAHEAD_MAX);
+      break;
+    case ADVICE_DONTNEED: {
+      rw_lock_acquire(&inode->map_lock, true);
+      off_t length = inode_length(inode);
+      for (off_t ofs = 0; ofs < length; ofs += BLOCK_SECTOR_SIZE)
+        buffer_cache_demote_block(byte_to_sector(inode, ofs));
+      page_cache_invalidate(inode->sector, 0);
+      rw_lock_release(&inode->map_lock, true);
+      break;
+    }
+    default:
+      lock_acquire(&inode->lock);
+      inode->advice = advice;
+      lock_release(&inode->lock);
+      break;
+  }
+}
+
+/* Returns how many whole sectors of the first LEN bytes at byte
+   offset OFFSET of INODE, whose sector is SECTOR, lie in
+   consecutive sectors from SECTOR on, up to DIRECT_MAX_SECTORS.
+   INODE's map lock must be held. */
+static size_t inode_direct_run(struct inode* inode, block_sector_t sector, off_t offset,
+                               off_t len) {
+  size_t cnt = 1;
+  while (cnt < DIRECT_MAX_SECTORS && (off_t)(cnt + 1) * BLOCK_SECTOR_SIZE <= len &&
+         byte_to_sector(inode, offset + cnt * BLOCK_SECTOR_SIZE) == sector + cnt)
+    cnt++;
+  return cnt;
+}
+
+/* Reads SIZE bytes at OFFSET of INODE, which must lie within the
+   file, into BUFFER through the page cache.  INODE's map lock
+   must be held. */
+static void inode_read_pages(struct inode* inode, uint8_t* buffer, off_t size, off_t offset) {
+  while (size > 0) {
+    size_t page_idx = offset / PGSIZE;
+    int page_ofs = offset % PGSIZE;
+    int chunk_size = size < PGSIZE - page_ofs ? size : PGSIZE - page_ofs;
+
+    struct page_cache_entry* pce = page_cache_acquire(inode, page_idx);
+    memcpy(buffer, pce->kpage + page_ofs, chunk_size);
+    page_cache_release(pce);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    buffer += chunk_size;
+  }
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET.  If DIRECT, whole sectors bypass the buffer cache.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
-off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset) {
+static off_t inode_read(struct inode* inode, void* buffer_, off_t size, off_t offset,
+                        bool direct) {
   uint8_t* buffer = buffer_;
   off_t bytes_read = 0;
+  bool noreuse = inode->advice == ADVICE_NOREUSE;
+
+  if (inode->ops != NULL)
+    return inode->ops->read_at(inode->aux, buffer_, size, offset);
 
   /* Update read boundaries if reading beyond EOF. */
   off_t inode_data_length = inode_length(inode);
@@ -294,6 +627,20 @@ off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset
     return 0;
   else if (offset + size > inode_data_length) /* Partial read beyond EOF. */
     size = inode_data_length - offset;        /* Only read up to EOF. */
+  bool paged = !direct && !noreuse && inode->sector != FREE_MAP_SECTOR && !inode_isdir(inode);
+
+  rw_lock_acquire(&inode->map_lock, true);
+
+  if (paged) {
+    /* The file may have shrunk before the map lock was taken. */
+    inode_data_length = inode_length(inode);
+    if (size > inode_data_length - offset)
+      size = offset < inode_data_length ? inode_data_length - offset : 0;
+    inode_read_pages(inode, buffer, size, offset);
+    bytes_read = size;
+    offset += size;
+    size = 0;
+  }
 
   while (size > 0) {
     /* Disk sector to read, starting byte offset within sector. */
@@ -310,14 +657,25 @@ off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset
     if (chunk_size <= 0)
       break;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
+    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE && direct) {
+      /* Read full sectors that are contiguous on disk into
+         caller's buffer in one request. */
+      size_t run =
+          inode_direct_run(inode, sector_idx, offset, size < inode_left ? size : inode_left);
+      buffer_cache_read_direct(sector_idx, run, buffer + bytes_read);
+      chunk_size = run * BLOCK_SECTOR_SIZE;
+    } else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
       /* Read full sector directly into caller's buffer. */
       struct buffer_cache_entry* bce = buffer_cache_acquire(sector_idx, false);
       memcpy(buffer + bytes_read, bce->block, BLOCK_SECTOR_SIZE);
+      if (noreuse)
+        buffer_cache_demote(bce);
       buffer_cache_release(bce);
     } else {
       struct buffer_cache_entry* bce = buffer_cache_acquire(sector_idx, false);
       memcpy(buffer + bytes_read, (uint8_t*)&bce->block[0] + sector_ofs, chunk_size);
+      if (noreuse)
+        buffer_cache_demote(bce);
       buffer_cache_release(bce);
     }
 
@@ -326,23 +684,66 @@ off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset
     offset += chunk_size;
     bytes_read += chunk_size;
   }
+  if (!direct && inode->advice == ADVICE_SEQUENTIAL)
+    inode_readahead(inode, offset, READAHEAD_SECTORS);
+  rw_lock_release(&inode->map_lock, true);
 
   return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached. */
+off_t inode_read_at(struct inode* inode, void* buffer, off_t size, off_t offset) {
+  return inode_read(inode, buffer, size, offset, false);
+}
+
+/* Like inode_read_at(), but whole sectors are read from disk
+   straight into BUFFER instead of passing through the buffer
+   cache, so that streaming reads do not evict it. */
+off_t inode_read_at_direct(struct inode* inode, void* buffer, off_t size, off_t offset) {
+  return inode_read(inode, buffer, size, offset, true);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   If DIRECT, whole sectors of file data bypass the buffer cache.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
    (Normally a write at end of file would extend the inode, but
    growth is not yet implemented.) */
-off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t offset) {
+static off_t inode_write(struct inode* inode, const void* buffer_, off_t size, off_t offset,
+                         bool direct) {
   const uint8_t* buffer = buffer_;
   off_t bytes_written = 0;
+  off_t start = offset;
+
+  if (inode->ops != NULL) {
+    lock_acquire(&inode->lock);
+    bool denied = inode->deny_write_cnt > 0;
+    lock_release(&inode->lock);
+    return denied ? 0 : inode->ops->write_at(inode->aux, buffer_, size, offset);
+  }
+
+  /* Directory and free map contents are metadata, so their data
+     blocks go through the journal as well. */
+  bool metadata = inode->sector == FREE_MAP_SECTOR || inode_isdir(inode);
+
+  /* Growing a file by a lot would log more than one transaction
+     may, so a regular file is grown in transactions of its own
+     first, unless the caller's transaction is already running. */
+  if (!metadata && thread_current()->journal_depth == 0 && offset + size > inode_length(inode) &&
+      !inode_grow(inode, offset + size, false))
+    return 0;
+
+  journal_begin();
+  rw_lock_acquire(&inode->map_lock, true);
 
   /* Check if file is denied from writing. */
   lock_acquire(&inode->lock);
   if (inode->deny_write_cnt) {
     lock_release(&inode->lock);
+    rw_lock_release(&inode->map_lock, true);
+    journal_end();
     return 0;
   }
 
@@ -354,17 +755,22 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
 
   /* Extend inode if write exceeds EOF. */
   if (offset + size > data->length) {
-    if (!inode_file_resize(data, offset + size)) { /* File extension fails. */
-      inode_file_resize(data, data->length);       /* Rollback file extension. */
+    if (!inode_file_resize(data, offset + size, inode)) { /* File extension fails. */
+      inode_file_resize(data, data->length, inode);         /* Rollback file extension. */
       free(data);
       lock_release(&inode->lock);
+      rw_lock_release(&inode->map_lock, true);
+      journal_end();
       return 0;
     }
 
     /* Update inode disk block in buffer cache. */
     struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, true);
     memcpy(bce->block, data, BLOCK_SECTOR_SIZE);
+    buffer_cache_dirty(bce, inode);
+    buffer_cache_log(bce);
     buffer_cache_release(bce);
+    inode->metadata_dirty = true;
   }
   free(data);
   lock_release(&inode->lock);
@@ -384,10 +790,20 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
     if (chunk_size <= 0)
       break;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
+    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE && direct && !metadata) {
+      /* Write full sectors that are contiguous on disk from
+         caller's buffer in one request. */
+      size_t run =
+          inode_direct_run(inode, sector_idx, offset, size < inode_left ? size : inode_left);
+      buffer_cache_write_direct(sector_idx, run, buffer + bytes_written);
+      chunk_size = run * BLOCK_SECTOR_SIZE;
+    } else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
       /* Write full sector directly to disk. */
       struct buffer_cache_entry* bce = buffer_cache_acquire(sector_idx, true);
       memcpy(bce->block, buffer + bytes_written, BLOCK_SECTOR_SIZE);
+      buffer_cache_dirty(bce, inode);
+      if (metadata)
+        buffer_cache_log(bce);
       buffer_cache_release(bce);
     } else {
       /* If the sector contains data before or after the chunk
@@ -397,6 +813,9 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
       if (!(sector_ofs > 0 || chunk_size < sector_left))
         memset(bce->block, 0, BLOCK_SECTOR_SIZE);
       memcpy(&bce->block[0] + sector_ofs, buffer + bytes_written, chunk_size);
+      buffer_cache_dirty(bce, inode);
+      if (metadata)
+        buffer_cache_log(bce);
       buffer_cache_release(bce);
     }
 
@@ -405,10 +824,212 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
     offset += chunk_size;
     bytes_written += chunk_size;
   }
+  if (!metadata)
+    page_cache_update(inode, buffer, bytes_written, start);
 
+  rw_lock_release(&inode->map_lock, true);
+  journal_end();
   return bytes_written;
 }
 
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs. */
+off_t inode_write_at(struct inode* inode, const void* buffer, off_t size, off_t offset) {
+  return inode_write(inode, buffer, size, offset, false);
+}
+
+/* Like inode_write_at(), but whole sectors of file data are
+   written from BUFFER straight to disk instead of passing through
+   the buffer cache.  Partial sectors, and the contents of
+   directories and the free map, are still cached. */
+off_t inode_write_at_direct(struct inode* inode, const void* buffer, off_t size, off_t offset) {
+  return inode_write(inode, buffer, size, offset, true);
+}
+
+/* Returns INODE's disk inode in a newly allocated copy, or a null
+   pointer if memory runs out.  INODE's lock must be held. */
+static struct inode_disk* inode_read_disk(struct inode* inode) {
+  struct inode_disk* data = malloc(sizeof *data);
+  if (data != NULL) {
+    struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, false);
+    memcpy(data, bce->block, BLOCK_SECTOR_SIZE);
+    buffer_cache_release(bce);
+  }
+  return data;
+}
+
+/* Writes DATA back as INODE's disk inode and logs it.  INODE's
+   lock must be held. */
+static void inode_write_disk(struct inode* inode, const struct inode_disk* data) {
+  struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, true);
+  memcpy(bce->block, data, BLOCK_SECTOR_SIZE);
+  buffer_cache_dirty(bce, inode);
+  buffer_cache_log(bce);
+  buffer_cache_release(bce);
+  inode->metadata_dirty = true;
+}
+
+/* Returns true if INODE is a regular file on the file system
+   device that may be resized by inode_truncate() and
+   inode_allocate(). */
+static bool inode_resizable(struct inode* inode) {
+  return inode->ops == NULL && inode->sector != FREE_MAP_SECTOR && !inode_isdir(inode);
+}
+
+/* Most sectors one transaction adds to a file.  Growing a file by
+   more takes several transactions, so that none logs more than
+   JOURNAL_TXN_BLOCKS sectors: a step changes the inode, its
+   indirect and doubly indirect blocks, at most three indirect
+   blocks under the latter, and the free map sectors that hold the
+   bits of one run of data blocks and of up to five new pointer
+   blocks, 13 sectors in all. */
+#define INODE_GROW_STEP 256
+
+/* Most sectors one transaction adds to a file when no run of
+   consecutive free sectors is long enough for a whole step.  The
+   data blocks are then allocated one at a time, and the bits of
+   each may lie in a different free map sector.  Such a step
+   touches at most two indirect blocks under the doubly indirect
+   block, so it logs up to 5 inode and pointer blocks, 4 free map
+   sectors for new pointer blocks and 1 per data block. */
+#define INODE_GROW_SCATTERED_STEP 7
+
+/* Grows INODE, a regular file, to LENGTH bytes, filling it with
+   zeros, in steps that are each a transaction of their own.  Each
+   step's new data blocks are taken as one run of up to
+   INODE_GROW_STEP consecutive sectors if possible, and otherwise
+   one at a time, INODE_GROW_SCATTERED_STEP at most.  If PREALLOC,
+   a run is zeroed on disk directly; otherwise its blocks are
+   zeroed in the buffer cache as they are taken, like those
+   allocated singly.  Returns true if INODE is at least
+   LENGTH bytes long afterward.  Otherwise, as when writes are
+   denied or the disk or memory is full, shrinks INODE back to its
+   length on entry and returns false.  Must not be called inside a
+   transaction. */
+static bool inode_grow(struct inode* inode, off_t length, bool prealloc) {
+  static const uint8_t zeros[PGSIZE];
+  off_t start_length = -1;
+  bool success = true;
+  bool done = false;
+
+  ASSERT(thread_current()->journal_depth == 0);
+  while (success && !done) {
+    journal_begin();
+    rw_lock_acquire(&inode->map_lock, true);
+    lock_acquire(&inode->lock);
+
+    struct inode_disk* data = inode->deny_write_cnt ? NULL : inode_read_disk(inode);
+    success = data != NULL;
+    if (data != NULL && start_length < 0)
+      start_length = data->length;
+    if (data != NULL && data->length >= length) {
+      done = true;
+    } else if (data != NULL) {
+      off_t old_length = data->length;
+      off_t step_length =
+          ROUND_DOWN(old_length, BLOCK_SECTOR_SIZE) + INODE_GROW_STEP * BLOCK_SECTOR_SIZE;
+      if (step_length >= length) {
+        step_length = length;
+        done = true;
+      }
+
+      struct inode_resize rs = {.owner = inode};
+      size_t cnt = bytes_to_sectors(step_length) - bytes_to_sectors(old_length);
+      if (cnt > 0 && free_map_allocate(cnt, &rs.run_start)) {
+        if (prealloc) {
+          for (size_t i = 0; i < cnt; i += PAGE_SECTORS) {
+            size_t zero_cnt = cnt - i < PAGE_SECTORS ? cnt - i : PAGE_SECTORS;
+            buffer_cache_write_direct(rs.run_start + i, zero_cnt, zeros);
+          }
+        } else
+          rs.run_zero = true;
+        rs.run_cnt = cnt;
+      } else if (cnt > INODE_GROW_SCATTERED_STEP) {
+        step_length = ROUND_DOWN(old_length, BLOCK_SECTOR_SIZE) +
+                      INODE_GROW_SCATTERED_STEP * BLOCK_SECTOR_SIZE;
+        done = false;
+      }
+
+      success = inode_resize_blocks(data, step_length, &rs);
+      inode_resize_finish(&rs);
+      if (success)
+        inode_write_disk(inode, data);
+      else
+        inode_file_resize(data, old_length, inode); /* Roll back a partial extension. */
+    }
+    free(data);
+
+    lock_release(&inode->lock);
+    rw_lock_release(&inode->map_lock, true);
+    journal_end();
+  }
+
+  if (!success && start_length >= 0)
+    inode_truncate(inode, start_length); /* Roll back earlier steps. */
+  return success;
+}
+
+/* Sets the length of INODE to LENGTH bytes.  Growing the file
+   fills it with zeros.  Shrinking it frees every data and pointer
+   block past the new end once the shrink commits, and zeros the
+   rest of the last sector so that growing the file again cannot
+   bring back old bytes.  Returns false if INODE is not a regular
+   file on the file system device, writes to it are denied, or the
+   disk or memory is full. */
+bool inode_truncate(struct inode* inode, off_t length) {
+  if (length < 0 || !inode_resizable(inode))
+    return false;
+  if (length > inode_length(inode))
+    return inode_grow(inode, length, false);
+
+  /* Shrinking frees blocks that readers may be using, so keep them
+     out entirely. */
+  journal_begin();
+  rw_lock_acquire(&inode->map_lock, false);
+  lock_acquire(&inode->lock);
+
+  bool success = false;
+  struct inode_disk* data = inode->deny_write_cnt ? NULL : inode_read_disk(inode);
+  if (data != NULL) {
+    off_t old_length = data->length;
+    success = inode_file_resize(data, length, inode);
+    if (success && length < old_length && length % BLOCK_SECTOR_SIZE != 0) {
+      block_sector_t sector = byte_to_sector(inode, length);
+      int sector_ofs = length % BLOCK_SECTOR_SIZE;
+      struct buffer_cache_entry* bce = buffer_cache_acquire(sector, true);
+      memset(bce->block + sector_ofs, 0, BLOCK_SECTOR_SIZE - sector_ofs);
+      buffer_cache_dirty(bce, inode);
+      buffer_cache_release(bce);
+    }
+    if (success && length < old_length)
+      page_cache_invalidate(inode->sector, length / PGSIZE);
+    if (success)
+      inode_write_disk(inode, data);
+    else
+      inode_file_resize(data, old_length, inode); /* Roll back a partial extension. */
+    free(data);
+  }
+
+  lock_release(&inode->lock);
+  rw_lock_release(&inode->map_lock, false);
+  journal_end();
+  return success;
+}
+
+/* Reserves disk space for bytes OFFSET through OFFSET + LEN - 1 of
+   INODE, extending it with zeros if it is shorter.  The new data
+   blocks are taken in runs of consecutive sectors, one free map
+   operation per INODE_GROW_STEP sectors, and zeroed on disk
+   directly, without passing through the buffer cache.  If no run
+   is long enough, they are allocated one at a time as by a write.
+   Returns false under the same conditions as inode_truncate(). */
+bool inode_allocate(struct inode* inode, off_t offset, off_t len) {
+  if (offset < 0 || len < 0 || offset > INODE_MAX_LENGTH - len || !inode_resizable(inode))
+    return false;
+  return inode_grow(inode, offset + len, true);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode* inode) {
@@ -431,6 +1052,8 @@ void inode_allow_write(struct inode* inode) {
 
 /* Returns the length, in bytes, of INODE's data. */
 off_t inode_length(const struct inode* inode) {
+  if (inode->ops != NULL)
+    return inode->ops->length(inode->aux);
   struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, false);
   struct inode_disk* data = (struct inode_disk*)bce->block;
   off_t inode_data_length = data->length;
@@ -438,26 +1061,298 @@ off_t inode_length(const struct inode* inode) {
   return inode_data_length;
 }
 
+/* Writes INODE's dirty blocks back to disk, found through its
+   dirty list rather than a scan of the whole cache.  Metadata is
+   made durable by committing the journal first.  If DATA_ONLY,
+   the inode sector is skipped, and the journal left alone, unless
+   the inode changed since it was last synced, as fdatasync()
+   requires.  Finally flushes the disk's write cache, so that the
+   writes are on the media.  Blocks written before INODE was
+   opened, such as those zeroed by inode_create(), are not
+   tracked. */
+void inode_sync(struct inode* inode, bool data_only) {
+  if (inode->ops != NULL)
+    return;
+
+  lock_acquire(&inode->lock);
+  bool sync_metadata = !data_only || inode->metadata_dirty;
+  inode->metadata_dirty = false;
+  lock_release(&inode->lock);
+
+  if (sync_metadata)
+    journal_commit();
+
+  /* Wait until none of the blocks to write is in use, so that
+     none is held while waiting for another. */
+  lock_acquire(&buffer_cache_lock);
+  struct list_elem* e = list_begin(&inode->dirty_blocks);
+  while (e != list_end(&inode->dirty_blocks)) {
+    struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, dirty_elem);
+    if (!bce->journaled && (sync_metadata || bce->block_id != inode->sector) &&
+        bce->ref_cnt > 0) {
+      /* The dirty list may change while we wait, so start over. */
+      cond_wait(&bce->cond, &buffer_cache_lock);
+      e = list_begin(&inode->dirty_blocks);
+    } else
+      e = list_next(e);
+  }
+
+  /* Hold each block, so that it cannot change until its write
+     completes, and submit all of the writes before waiting for
+     any.  A written block is clean and off INODE's dirty list, so
+     its dirty list element links it into WRITING meanwhile. */
+  struct list writing;
+  struct semaphore done;
+  list_init(&writing);
+  sema_init(&done, 0);
+  e = list_begin(&inode->dirty_blocks);
+  while (e != list_end(&inode->dirty_blocks)) {
+    struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, dirty_elem);
+    e = list_next(e);
+    if (bce->journaled || (!sync_metadata && bce->block_id == inode->sector))
+      continue;
+    bce->ref_cnt++;
+    buffer_cache_clean(bce);
+    list_push_back(&writing, &bce->dirty_elem);
+    buffer_cache_submit(bce, true, thread_get_priority(), &done);
+  }
+  lock_release(&buffer_cache_lock);
+
+  for (e = list_begin(&writing); e != list_end(&writing); e = list_next(e))
+    sema_down(&done);
+
+  lock_acquire(&buffer_cache_lock);
+  while (!list_empty(&writing)) {
+    e = list_pop_front(&writing);
+    buffer_cache_release_locked(list_entry(e, struct buffer_cache_entry, dirty_elem));
+  }
+  lock_release(&buffer_cache_lock);
+  block_flush(fs_device);
+}
+
+/* Most data blocks inode_defrag() relocates in one transaction.
+   Reads and writes of the file wait only for one such run. */
+#define DEFRAG_RUN_MAX 64
+
+/* Returns true if the CNT data blocks of INODE starting at block
+   IDX are stored in consecutive sectors. */
+static bool inode_blocks_contiguous(struct inode* inode, size_t idx, size_t cnt) {
+  block_sector_t first = byte_to_sector(inode, idx * BLOCK_SECTOR_SIZE);
+  for (size_t i = 1; i < cnt; i++)
+    if (byte_to_sector(inode, (idx + i) * BLOCK_SECTOR_SIZE) != first + i)
+      return false;
+  return true;
+}
+
+/* Points data block IDX of INODE at SECTOR, logging the pointer
+   block that changes, and returns the sector it pointed at. */
+static block_sector_t inode_swap_block(struct inode* inode, size_t idx, block_sector_t sector) {
+  struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, false);
+  struct inode_disk* data = (struct inode_disk*)bce->block;
+  block_sector_t data_ip = data->ip;
+  block_sector_t data_dip = data->dip;
+  buffer_cache_release(bce);
+
+  /* Find the pointer block and the slot within it. */
+  block_sector_t ptr_sector;
+  size_t slot;
+  if (idx < INODE_NUM_DP) {
+    ptr_sector = inode->sector;
+    slot = offsetof(struct inode_disk, dp) / sizeof(block_sector_t) + idx;
+  } else if (idx < INODE_NUM_DP + 128) {
+    ptr_sector = data_ip;
+    slot = idx - INODE_NUM_DP;
+  } else {
+    idx -= INODE_NUM_DP + 128;
+    bce = buffer_cache_acquire(data_dip, false);
+    ptr_sector = ((block_sector_t*)bce->block)[idx / 128];
+    buffer_cache_release(bce);
+    slot = idx % 128;
+  }
+
+  bce = buffer_cache_acquire(ptr_sector, true);
+  block_sector_t* ptrs = (block_sector_t*)bce->block;
+  block_sector_t old = ptrs[slot];
+  ptrs[slot] = sector;
+  buffer_cache_dirty(bce, inode);
+  buffer_cache_log(bce);
+  buffer_cache_release(bce);
+
+  if (ptr_sector == inode->sector) {
+    lock_acquire(&inode->lock);
+    inode->metadata_dirty = true;
+    lock_release(&inode->lock);
+  }
+  return old;
+}
+
+/* Moves the data blocks of INODE into contiguous runs of free
+   sectors, while the file stays open to other readers and
+   writers.  The file is processed in runs of up to DEFRAG_RUN_MAX
+   blocks; a run that is already contiguous is left alone, and one
+   for which no free run is large enough is split in halves.  A
+   run's blocks are copied with direct transfers, one per stretch
+   of consecutive old sectors and one for the whole new run, and
+   flushed to the disk's media before the pointers naming them are
+   logged, so a crash leaves either the old or the new layout.
+   The old blocks are freed in the same transaction, which keeps
+   them from being reused until it has committed.  Returns the
+   number of blocks moved, which is 0 if memory runs out, or -1 if
+   INODE is a directory, the free map, or not on the file system
+   device. */
+int inode_defrag(struct inode* inode) {
+  if (inode->ops != NULL || inode->sector == FREE_MAP_SECTOR || inode_isdir(inode))
+    return -1;
+
+  size_t bounce_pages = DEFRAG_RUN_MAX / PAGE_SECTORS;
+  uint8_t* bounce = palloc_get_multiple(0, bounce_pages);
+  if (bounce == NULL)
+    return 0;
+
+  block_sector_t olds[DEFRAG_RUN_MAX];
+  int moved_cnt = 0;
+  size_t idx = 0;
+  size_t run = DEFRAG_RUN_MAX;
+  for (;;) {
+    journal_begin();
+    rw_lock_acquire(&inode->map_lock, false);
+
+    /* The file may have grown or shrunk since the last run. */
+    size_t sector_cnt = bytes_to_sectors(inode_length(inode));
+    if (idx >= sector_cnt) {
+      rw_lock_release(&inode->map_lock, false);
+      journal_end();
+      break;
+    }
+    size_t cnt = sector_cnt - idx < run ? sector_cnt - idx : run;
+
+    block_sector_t start;
+    if (inode_blocks_contiguous(inode, idx, cnt)) {
+      idx += cnt;
+      run = DEFRAG_RUN_MAX;
+    } else if (free_map_allocate(cnt, &start)) {
+      size_t i, j;
+      for (i = 0; i < cnt; i++)
+        olds[i] = byte_to_sector(inode, (idx + i) * BLOCK_SECTOR_SIZE);
+      for (i = 0; i < cnt; i = j) {
+        for (j = i + 1; j < cnt && olds[j] == olds[j - 1] + 1; j++)
+          continue;
+        buffer_cache_read_direct(olds[i], j - i, bounce + i * BLOCK_SECTOR_SIZE);
+      }
+      buffer_cache_write_direct(start, cnt, bounce);
+      block_flush(fs_device);
+
+      for (i = 0; i < cnt; i++) {
+        inode_swap_block(inode, idx + i, start + i);
+        buffer_cache_discard(olds[i]);
+      }
+      free_map_release_multiple(olds, cnt);
+      moved_cnt += cnt;
+      idx += cnt;
+      run = DEFRAG_RUN_MAX;
+    } else {
+      /* No free run is large enough; retry with half as many.  A
+         single block always counts as contiguous, so this ends. */
+      run = cnt / 2;
+    }
+
+    rw_lock_release(&inode->map_lock, false);
+    journal_end();
+  }
+
+  palloc_free_multiple(bounce, bounce_pages);
+  return moved_cnt;
+}
+
 /* Resize an inode disk to SIZE bytes. Inode disk is not updated in block device.
     All other data/pointer blocks are updated in disk. If resize fails, inode disk file size
-    is not updated. */
-static bool inode_file_resize(struct inode_disk* data, off_t size) {
+    is not updated. Blocks written are added to OWNER's dirty list, if OWNER is non-null.
+    Blocks given up are freed together, in one free map update. */
+static bool inode_file_resize(struct inode_disk* data, off_t size, struct inode* owner) {
+  struct inode_resize rs = {.owner = owner};
+  bool success = inode_resize_blocks(data, size, &rs);
+  inode_resize_finish(&rs);
+  return success;
+}
+
+/* Gets a zeroed data block for a resize into *SECTORP, taking the
+   next sector of RS's preallocated run if any is left, or else
+   allocating one.  Zeroes it in the cache unless it comes from a
+   run already zeroed on disk.  Returns false if the disk is
+   full. */
+static bool resize_alloc_data(struct inode_resize* rs, block_sector_t* sectorp) {
+  if (rs->run_cnt > 0) {
+    *sectorp = rs->run_start++;
+    rs->run_cnt--;
+    if (!rs->run_zero)
+      return true;
+  } else if (!free_map_allocate(1, sectorp))
+    return false;
+  struct buffer_cache_entry* bce = buffer_cache_acquire(*sectorp, true);
+  memset(bce->block, 0, BLOCK_SECTOR_SIZE);
+  buffer_cache_dirty(bce, rs->owner);
+  buffer_cache_release(bce);
+  return true;
+}
+
+/* Queues SECTOR to be freed when RS finishes.  Frees it at once if
+   there is no memory to queue it. */
+static void resize_release(struct inode_resize* rs, block_sector_t sector) {
+  if (rs->released_cnt == rs->released_cap) {
+    size_t cap = rs->released_cap ? 2 * rs->released_cap : 128;
+    block_sector_t* released = realloc(rs->released, cap * sizeof *released);
+    if (released == NULL) {
+      free_map_release(sector, 1);
+      return;
+    }
+    rs->released = released;
+    rs->released_cap = cap;
+  }
+  rs->released[rs->released_cnt++] = sector;
+}
+
+/* Frees the sectors RS queued, along with any left of its
+   preallocated run, in one free map update. */
+static void inode_resize_finish(struct inode_resize* rs) {
+  while (rs->run_cnt > 0) {
+    resize_release(rs, rs->run_start++);
+    rs->run_cnt--;
+  }
+  free_map_release_multiple(rs->released, rs->released_cnt);
+  free(rs->released);
+}
+
+/* Writes PTRS, a block of pointers that a resize through RS
+   changed, to pointer block SECTOR through the buffer cache, and
+   logs it. */
+static void inode_resize_write_ptrs(block_sector_t sector, const block_sector_t* ptrs,
+                                    struct inode_resize* rs) {
+  struct buffer_cache_entry* bce = buffer_cache_acquire(sector, true);
+  memcpy(bce->block, ptrs, BLOCK_SECTOR_SIZE);
+  buffer_cache_dirty(bce, rs->owner);
+  buffer_cache_log(bce);
+  buffer_cache_release(bce);
+}
+
+/* Resizes DATA to SIZE bytes on behalf of inode_file_resize(),
+   taking new data blocks and queuing freed blocks through RS.
+   Only pointer blocks whose contents change are written and
+   logged; those given up are freed without being written, since
+   nothing points to them once the resize commits. */
+static bool inode_resize_blocks(struct inode_disk* data, off_t size, struct inode_resize* rs) {
   /* Check resize requets is valid. */
-  if (size < 0 || size > (INODE_NUM_DP + 128 + 128 * 128) * BLOCK_SECTOR_SIZE)
+  if (size < 0 || size > INODE_MAX_LENGTH)
     return false;
 
   /* Iterate over direct pointers */
   block_sector_t* dp = data->dp;
   for (int i = 0; i < INODE_NUM_DP; i++) {
     if (size <= i * BLOCK_SECTOR_SIZE && dp[i] != 0) { /* Shrink file. */
-      free_map_release(dp[i], 1);
+      resize_release(rs, dp[i]);
       dp[i] = 0;
     } else if (size > i * BLOCK_SECTOR_SIZE && dp[i] == 0) { /* Grow file. */
-      if (!free_map_allocate(1, &dp[i]))
+      if (!resize_alloc_data(rs, &dp[i]))
         return false;
-      struct buffer_cache_entry* bce = buffer_cache_acquire(dp[i], true);
-      memset(bce->block, 0, BLOCK_SECTOR_SIZE);
-      buffer_cache_release(bce);
     }
   }
 
@@ -469,8 +1364,12 @@ static bool inode_file_resize(struct inode_disk* data, off_t size) {
   }
 
   block_sector_t* bounce_ip = calloc(128, sizeof(block_sector_t));
+  bool changed = *ip == 0;
   if (*ip == 0) { /* Indirect pointer unallocated. */
-    free_map_allocate(1, ip);
+    if (!free_map_allocate(1, ip)) {
+      free(bounce_ip);
+      return false;
+    }
   } else {
     /* Read indirect pointer block from disk. */
     struct buffer_cache_entry* bce = buffer_cache_acquire(*ip, false);
@@ -481,31 +1380,26 @@ static bool inode_file_resize(struct inode_disk* data, off_t size) {
   /* Iterate over direct pointers. */
   for (int i = 0; i < 128; i++) {
     if (size <= (INODE_NUM_DP + i) * BLOCK_SECTOR_SIZE && bounce_ip[i] != 0) { /* Shrink file. */
-      free_map_release(bounce_ip[i], 1);
+      resize_release(rs, bounce_ip[i]);
       bounce_ip[i] = 0;
+      changed = true;
     } else if (size > (INODE_NUM_DP + i) * BLOCK_SECTOR_SIZE &&
                bounce_ip[i] == 0) { /* Grow file. */
-      if (!free_map_allocate(1, &bounce_ip[i])) {
+      if (!resize_alloc_data(rs, &bounce_ip[i])) {
+        inode_resize_write_ptrs(*ip, bounce_ip, rs);
         free(bounce_ip);
         return false;
       }
-      /* Set block to zero. */
-      struct buffer_cache_entry* bce = buffer_cache_acquire(bounce_ip[i], true);
-      memset(bce->block, 0, BLOCK_SECTOR_SIZE);
-      buffer_cache_release(bce);
+      changed = true;
     }
   }
 
-  struct buffer_cache_entry* bce = buffer_cache_acquire(*ip, true);
-  memcpy(bce->block, bounce_ip, BLOCK_SECTOR_SIZE);
-  buffer_cache_release(bce);
-
-  free(bounce_ip);
-
   if (size <= INODE_NUM_DP * BLOCK_SECTOR_SIZE) { /* Unallocate indirect pointer if not needed. */
-    free_map_release(*ip, 1);
+    resize_release(rs, *ip);
     *ip = 0;
-  }
+  } else if (changed)
+    inode_resize_write_ptrs(*ip, bounce_ip, rs);
+  free(bounce_ip);
 
   /* Return if DIP unallocated and not needed. */
   block_sector_t* dip = &data->dip;
@@ -516,8 +1410,12 @@ static bool inode_file_resize(struct inode_disk* data, off_t size) {
 
   /* Load DIP buffer. */
   block_sector_t* bounce_dip = calloc(128, sizeof(block_sector_t));
+  bool dip_changed = *dip == 0;
   if (*dip == 0) {
-    free_map_allocate(1, dip);
+    if (!free_map_allocate(1, dip)) {
+      free(bounce_dip);
+      return false;
+    }
   } else {
     /* Read DIP block from disk. */
     struct buffer_cache_entry* bce = buffer_cache_acquire(*dip, false);
@@ -531,8 +1429,15 @@ static bool inode_file_resize(struct inode_disk* data, off_t size) {
       break;
 
     bounce_ip = calloc(128, sizeof(block_sector_t));
+    changed = bounce_dip[i] == 0;
     if (bounce_dip[i] == 0) { /* Indirect pointer unallocated. */
-      free_map_allocate(1, &bounce_dip[i]);
+      if (!free_map_allocate(1, &bounce_dip[i])) {
+        inode_resize_write_ptrs(*dip, bounce_dip, rs);
+        free(bounce_dip);
+        free(bounce_ip);
+        return false;
+      }
+      dip_changed = true;
     } else {
       /* Read indirect pointer block from disk. */
       struct buffer_cache_entry* bce = buffer_cache_acquire(bounce_dip[i], false);
@@ -543,59 +1448,59 @@ static bool inode_file_resize(struct inode_disk* data, off_t size) {
     for (int j = 0; j < 128; j++) { /* Iterate over direct pointers. */
       if (size <= (INODE_NUM_DP + 128 + 128 * i + j) * BLOCK_SECTOR_SIZE &&
           bounce_ip[j] != 0) { /* Shrink file. */
-        free_map_release(bounce_ip[j], 1);
+        resize_release(rs, bounce_ip[j]);
         bounce_ip[j] = 0;
+        changed = true;
       } else if (size > (INODE_NUM_DP + 128 + 128 * i + j) * BLOCK_SECTOR_SIZE &&
                  bounce_ip[j] == 0) { /* Grow file. */
-        if (!free_map_allocate(1, &bounce_ip[j])) {
+        if (!resize_alloc_data(rs, &bounce_ip[j])) {
+          inode_resize_write_ptrs(bounce_dip[i], bounce_ip, rs);
+          inode_resize_write_ptrs(*dip, bounce_dip, rs);
           free(bounce_dip);
           free(bounce_ip);
           return false;
         }
-        /* Set data block to zero. */
-        struct buffer_cache_entry* bce = buffer_cache_acquire(bounce_ip[j], true);
-        memset(bce->block, 0, BLOCK_SECTOR_SIZE);
-        buffer_cache_release(bce);
+        changed = true;
       }
     }
 
-    /* Write indirect block to disk (through buffer cache). */
-    struct buffer_cache_entry* bce = buffer_cache_acquire(bounce_dip[i], true);
-    memcpy(bce->block, bounce_ip, BLOCK_SECTOR_SIZE);
-    buffer_cache_release(bce);
-    free(bounce_ip);
-
     if (size <= (INODE_NUM_DP + 128 + 128 * i) * BLOCK_SECTOR_SIZE) {
       /* Unallocate IP block. */
-      free_map_release(bounce_dip[i], 1);
+      resize_release(rs, bounce_dip[i]);
       bounce_dip[i] = 0;
-    }
+      dip_changed = true;
+    } else if (changed)
+      inode_resize_write_ptrs(bounce_dip[i], bounce_ip, rs);
+    free(bounce_ip);
   }
 
-  /* Write DIP block to disk (through buffer cache). */
-  bce = buffer_cache_acquire(*dip, true);
-  memcpy(bce->block, bounce_dip, BLOCK_SECTOR_SIZE);
-  buffer_cache_release(bce);
-  free(bounce_dip);
-
   if (size <= (INODE_NUM_DP + 128) * BLOCK_SECTOR_SIZE) {
     /* Unallocate DIP block. */
-    free_map_release(*dip, 1);
+    resize_release(rs, *dip);
     *dip = 0;
-  }
+  } else if (dip_changed)
+    inode_resize_write_ptrs(*dip, bounce_dip, rs);
+  free(bounce_dip);
 
   data->length = size;
   return true;
 }
 
 void inode_set_isdir(struct inode* inode, bool value) {
+  journal_begin();
   struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, true);
   struct inode_disk* data = (struct inode_disk*)bce->block;
   data->is_dir = value;
+  buffer_cache_dirty(bce, inode);
+  buffer_cache_log(bce);
   buffer_cache_release(bce);
+  inode->metadata_dirty = true;
+  journal_end();
 }
 
 bool inode_isdir(struct inode* inode) {
+  if (inode->ops != NULL)
+    return false;
   struct buffer_cache_entry* bce = buffer_cache_acquire(inode->sector, false);
   struct inode_disk* data = (struct inode_disk*)bce->block;
   bool ret = (bool)data->is_dir;
@@ -603,6 +1508,18 @@ bool inode_isdir(struct inode* inode) {
   return ret;
 }
 
+/* Acquires INODE's directory lock, shared if READER is true and
+   exclusive otherwise.  Lookups and readdirs of a directory may
+   run concurrently; adding or removing entries may not. */
+void inode_lock_dir(struct inode* inode, bool reader) {
+  rw_lock_acquire(&inode->dir_lock, reader);
+}
+
+/* Releases INODE's directory lock, acquired with the same READER. */
+void inode_unlock_dir(struct inode* inode, bool reader) {
+  rw_lock_release(&inode->dir_lock, reader);
+}
+
 int inode_open_cnt(struct inode* inode) {
   lock_acquire(&inode->lock);
   int open_cnt = inode->open_cnt;
@@ -614,59 +1531,183 @@ int inode_open_cnt(struct inode* inode) {
 void buffer_cache_init(void) {
   list_init(&available_cache);
   lock_init(&buffer_cache_lock);
+  cond_init(&buffer_cache_freed);
   for (int i = 0; i < 64; i++) {
     buffer_cache[i].valid = false;
+    buffer_cache[i].journaled = false;
+    buffer_cache[i].dirty = false;
+    buffer_cache[i].owner = NULL;
     cond_init(&buffer_cache[i].cond);
     list_push_back(&available_cache, &buffer_cache[i].elem);
   }
   buffer_cache_access_cnt = 0;
   buffer_cache_hit_cnt = 0;
+
+  lock_init(&readahead_lock);
+  cond_init(&readahead_cond);
+  readahead_head = readahead_cnt = 0;
+  thread_create("readahead", PRI_DEFAULT, readahead_thread, NULL);
+
+  page_cache_init();
 }
 
 void buffer_cache_done(void) { buffer_cache_flush(); }
 
+/* Marks BCE clean and removes it from its owner's dirty list.
+   Buffer cache lock must be held. */
+static void buffer_cache_clean(struct buffer_cache_entry* bce) {
+  bce->dirty = false;
+  if (bce->owner != NULL) {
+    list_remove(&bce->dirty_elem);
+    bce->owner = NULL;
+  }
+}
+
+/* Called when a buffer cache read or write-back submitted with a
+   semaphore as its auxiliary data completes. */
+static void buffer_cache_io_done(struct block_request* r) { sema_up(r->aux); }
+
+/* Submits an asynchronous transfer of BCE's block, a write if
+   WRITE and a read otherwise, with I/O priority PRIORITY, that
+   ups DONE when it completes. */
+static void buffer_cache_submit(struct buffer_cache_entry* bce, bool write, int priority,
+                                struct semaphore* done) {
+  bce->io.sector = bce->block_id;
+  bce->io.cnt = 1;
+  bce->io.buffer = bce->block;
+  bce->io.write = write;
+  bce->io.priority = priority;
+  bce->io.done = buffer_cache_io_done;
+  bce->io.aux = done;
+  block_submit(fs_device, &bce->io);
+}
+
+/* Flush dirty blocks in buffer cache to disk. Blocks pinned by the
+   journal are skipped, since they may not reach their home
+   location before their group commits. Waits until none of the
+   blocks to write is in use, then holds each one until its write
+   completes, so that no change made after it was marked clean can
+   be lost. All of the writes are submitted before waiting for
+   any, so that the device can work through them back to back.
+   Buffer cache lock must be held; it is released while the
+   writes are in flight. */
+static void buffer_cache_flush_locked(void) {
+  struct list_elem* e = list_begin(&available_cache);
+  while (e != list_end(&available_cache)) {
+    struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, elem);
+    if (bce->valid && bce->dirty && !bce->journaled && bce->ref_cnt > 0) {
+      /* The cache may change while we wait, so start over. */
+      cond_wait(&bce->cond, &buffer_cache_lock);
+      e = list_begin(&available_cache);
+    } else
+      e = list_next(e);
+  }
+
+  /* A written block is clean and off its owner's dirty list, so
+     its dirty list element links it into WRITING meanwhile. */
+  struct list writing;
+  struct semaphore done;
+  list_init(&writing);
+  sema_init(&done, 0);
+  for (e = list_begin(&available_cache); e != list_end(&available_cache); e = list_next(e)) {
+    struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, elem);
+    if (bce->valid && bce->dirty && !bce->journaled) {
+      bce->ref_cnt++;
+      buffer_cache_clean(bce);
+      list_push_back(&writing, &bce->dirty_elem);
+      buffer_cache_submit(bce, true, thread_get_priority(), &done);
+    }
+  }
+
+  lock_release(&buffer_cache_lock);
+  for (e = list_begin(&writing); e != list_end(&writing); e = list_next(e))
+    sema_down(&done);
+  lock_acquire(&buffer_cache_lock);
+
+  while (!list_empty(&writing)) {
+    e = list_pop_front(&writing);
+    buffer_cache_release_locked(list_entry(e, struct buffer_cache_entry, dirty_elem));
+  }
+}
+
 /* Flush dirty blocks in buffer cache to disk. */
 void buffer_cache_flush(void) {
+  lock_acquire(&buffer_cache_lock);
+  buffer_cache_flush_locked();
+  lock_release(&buffer_cache_lock);
+}
+
+/* Returns the valid cache entry for BLOCK_ID, or NULL if the block
+   is not cached. Buffer cache lock must be held. */
+static struct buffer_cache_entry* buffer_cache_lookup(block_sector_t block_id) {
   for (struct list_elem* e = list_begin(&available_cache); e != list_end(&available_cache);
        e = list_next(e)) {
     struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, elem);
-    if (bce->valid && bce->dirty) {
-      block_write(fs_device, bce->block_id, bce->block);
-      bce->dirty = false;
-    }
+    if (bce->valid && bce->block_id == block_id)
+      return bce;
+  }
+  return NULL;
+}
+
+/* Returns the least recently used entry that may be evicted: one
+   that is neither in use nor pinned by the journal. Returns NULL
+   if there is none; buffer_cache_freed is signaled when one
+   becomes free. Buffer cache lock must be held. */
+static struct buffer_cache_entry* buffer_cache_victim(void) {
+  for (struct list_elem* e = list_rbegin(&available_cache); e != list_rend(&available_cache);
+       e = list_prev(e)) {
+    struct buffer_cache_entry* bce = list_entry(e, struct buffer_cache_entry, elem);
+    if (bce->ref_cnt == 0 && !bce->journaled)
+      return bce;
   }
+  return NULL;
+}
+
+/* Evicts BCE, which must have been removed from the available
+   cache list, and assigns it to block BLOCK_ID, whose data the
+   caller must read in. Buffer cache lock must be held. */
+static void buffer_cache_claim(struct buffer_cache_entry* bce, block_sector_t block_id) {
+  ASSERT(bce->ref_cnt == 0 && !bce->journaled);
+
+  /* Write dirty block to disk. */
+  if (bce->valid && bce->dirty)
+    block_write(fs_device, bce->block_id, bce->block);
+
+  /* Initialize new buffer cache entry. */
+  buffer_cache_clean(bce);
+  bce->block_id = block_id;
+  bce->valid = true;
+  bce->journaled = false;
+  bce->ref_cnt = 0;
+}
+
+/* Evicts BCE, which must have been removed from the available
+   cache list, and fills it with block BLOCK_ID from disk. Buffer
+   cache lock must be held. */
+static void buffer_cache_fill(struct buffer_cache_entry* bce, block_sector_t block_id) {
+  buffer_cache_claim(bce, block_id);
+  block_read(fs_device, block_id, bce->block);
 }
 
 struct buffer_cache_entry* buffer_cache_acquire(block_sector_t block_id, bool write) {
   lock_acquire(&buffer_cache_lock);
   buffer_cache_access_cnt += 1;
 
-  /* Search for BCE in cache. */
-  struct buffer_cache_entry* bce = NULL;
-  for (struct list_elem* e = list_begin(&available_cache); e != list_end(&available_cache);
-       e = list_next(e)) {
-    struct buffer_cache_entry* available_bce = list_entry(e, struct buffer_cache_entry, elem);
-    if (available_bce->valid && available_bce->block_id == block_id) {
-      bce = available_bce;
-      break;
-    }
+  /* Search for BCE in cache. If it is missing and every entry is
+     in use or pinned, wait for one to be released or unpinned;
+     another thread may read the block in meanwhile. */
+  struct buffer_cache_entry* bce = buffer_cache_lookup(block_id);
+  struct buffer_cache_entry* victim = NULL;
+  while (bce == NULL && (victim = buffer_cache_victim()) == NULL) {
+    cond_wait(&buffer_cache_freed, &buffer_cache_lock);
+    bce = buffer_cache_lookup(block_id);
   }
 
   if (!bce) { /* Evict cache block. */
     /* Get LRU buffer cache entry. */
-    struct list_elem* e = list_pop_back(&available_cache);
-    bce = list_entry(e, struct buffer_cache_entry, elem);
-
-    /* Write dirty block to disk. */
-    if (bce->valid && bce->dirty)
-      block_write(fs_device, bce->block_id, bce->block);
-
-    /* Initialize new buffer cache entry. */
-    block_read(fs_device, block_id, bce->block);
-    bce->block_id = block_id;
-    bce->valid = true;
-    bce->dirty = false;
-    bce->ref_cnt = 0;
+    bce = victim;
+    list_remove(&bce->elem);
+    buffer_cache_fill(bce, block_id);
   } else { /* Cache entry found. */
     buffer_cache_hit_cnt += 1;
     while (bce->ref_cnt > 0)
@@ -688,25 +1729,629 @@ struct buffer_cache_entry* buffer_cache_acquire(block_sector_t block_id, bool wr
 
 void buffer_cache_release(struct buffer_cache_entry* bce) {
   lock_acquire(&buffer_cache_lock);
+  buffer_cache_release_locked(bce);
+  lock_release(&buffer_cache_lock);
+}
+
+/* Records that BCE, acquired for writing, holds data of OWNER, so
+   that syncing OWNER writes it back. Does nothing if OWNER is
+   null, as for blocks written before their inode is opened. */
+void buffer_cache_dirty(struct buffer_cache_entry* bce, struct inode* owner) {
+  if (owner == NULL || bce->owner == owner)
+    return;
+  lock_acquire(&buffer_cache_lock);
+  if (bce->dirty) {
+    if (bce->owner != NULL)
+      list_remove(&bce->dirty_elem);
+    bce->owner = owner;
+    list_push_back(&owner->dirty_blocks, &bce->dirty_elem);
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Waits until none of the CNT blocks starting at BLOCK_ID is
+   cached and in use, then holds each of them that is cached, so
+   that it can be neither changed nor evicted until released with
+   buffer_cache_release_locked().  Returns a mask with bit I set
+   if block BLOCK_ID + I is held.  CNT may be at most
+   DIRECT_MAX_SECTORS.  Buffer cache lock must be held. */
+static uint64_t buffer_cache_hold_cached(block_sector_t block_id, size_t cnt) {
+  uint64_t held = 0;
+  size_t i = 0;
+
+  ASSERT(cnt <= DIRECT_MAX_SECTORS);
+  while (i < cnt) {
+    struct buffer_cache_entry* bce = buffer_cache_lookup(block_id + i);
+    if (bce != NULL && bce->ref_cnt > 0) {
+      /* The cache may change while we wait, so start over. */
+      cond_wait(&bce->cond, &buffer_cache_lock);
+      i = 0;
+      continue;
+    }
+    i++;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    struct buffer_cache_entry* bce = buffer_cache_lookup(block_id + i);
+    if (bce != NULL) {
+      bce->ref_cnt++;
+      held |= (uint64_t)1 << i;
+    }
+  }
+  return held;
+}
+
+/* Lets go of BCE, acquired or held by the caller.  Buffer cache
+   lock must be held. */
+static void buffer_cache_release_locked(struct buffer_cache_entry* bce) {
   bce->ref_cnt -= 1;
   cond_signal(&bce->cond, &buffer_cache_lock);
+  if (bce->ref_cnt == 0 && !bce->journaled)
+    cond_broadcast(&buffer_cache_freed, &buffer_cache_lock);
+}
+
+/* Returns kernel memory to bounce a direct transfer of CNT blocks
+   of user data through, and stores in *BOUNCE_CNT how many blocks
+   it holds: pages enough for a whole device request if they can
+   be had, else a single page, else SECTOR, a block of the
+   caller's stack.  Free with buffer_cache_bounce_put(). */
+static uint8_t* buffer_cache_bounce_get(size_t cnt, uint8_t* sector, size_t* bounce_cnt) {
+  if (cnt > DIRECT_MAX_SECTORS)
+    cnt = DIRECT_MAX_SECTORS;
+  size_t page_cnt = DIV_ROUND_UP(cnt, PAGE_SECTORS);
+  uint8_t* bounce = palloc_get_multiple(0, page_cnt);
+  if (bounce == NULL && page_cnt > 1) {
+    page_cnt = 1;
+    bounce = palloc_get_page(0);
+  }
+  if (bounce == NULL) {
+    *bounce_cnt = 1;
+    return sector;
+  }
+  *bounce_cnt = page_cnt * PAGE_SECTORS;
+  return bounce;
+}
+
+/* Frees BOUNCE, of BOUNCE_CNT blocks, from
+   buffer_cache_bounce_get() given SECTOR. */
+static void buffer_cache_bounce_put(uint8_t* bounce, uint8_t* sector, size_t bounce_cnt) {
+  if (bounce != sector)
+    palloc_free_multiple(bounce, bounce_cnt / PAGE_SECTORS);
+}
+
+/* Reads the CNT blocks starting at BLOCK_ID into BUFFER without
+   caching them, in a single device request per
+   DIRECT_MAX_SECTORS blocks unless all of them are cached.
+   Cached copies, which may be newer than the disk, take the
+   place of what was read.  They are held while the device works,
+   so that none can be written back and evicted in between, but
+   the buffer cache lock is not.
+
+   Drivers carry out requests in their own threads and interrupt
+   handlers, and may transfer by DMA, so a request's buffer must
+   be kernel memory.  A user BUFFER is filled through kernel pages
+   from buffer_cache_bounce_get() instead. */
+static void buffer_cache_read_direct(block_sector_t block_id, size_t cnt, void* buffer_) {
+  uint8_t* buffer = buffer_;
+
+  if (!is_kernel_vaddr(buffer)) {
+    uint8_t sector[BLOCK_SECTOR_SIZE];
+    size_t bounce_cnt;
+    uint8_t* bounce = buffer_cache_bounce_get(cnt, sector, &bounce_cnt);
+    for (size_t i = 0; i < cnt; i += bounce_cnt) {
+      size_t n = cnt - i < bounce_cnt ? cnt - i : bounce_cnt;
+      buffer_cache_read_direct(block_id + i, n, bounce);
+      memcpy(buffer + i * BLOCK_SECTOR_SIZE, bounce, n * BLOCK_SECTOR_SIZE);
+    }
+    buffer_cache_bounce_put(bounce, sector, bounce_cnt);
+    return;
+  }
+
+  for (; cnt > DIRECT_MAX_SECTORS; cnt -= DIRECT_MAX_SECTORS) {
+    buffer_cache_read_direct(block_id, DIRECT_MAX_SECTORS, buffer);
+    block_id += DIRECT_MAX_SECTORS;
+    buffer += DIRECT_MAX_SECTORS * BLOCK_SECTOR_SIZE;
+  }
+
+  lock_acquire(&buffer_cache_lock);
+  uint64_t held = buffer_cache_hold_cached(block_id, cnt);
+  lock_release(&buffer_cache_lock);
+
+  if (held != ((uint64_t)2 << (cnt - 1)) - 1)
+    block_read_multiple(fs_device, block_id, cnt, buffer);
+
+  lock_acquire(&buffer_cache_lock);
+  for (size_t i = 0; i < cnt; i++) {
+    if (held & ((uint64_t)1 << i)) {
+      struct buffer_cache_entry* bce = buffer_cache_lookup(block_id + i);
+      memcpy(buffer + i * BLOCK_SECTOR_SIZE, bce->block, BLOCK_SECTOR_SIZE);
+      buffer_cache_release_locked(bce);
+    }
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Writes BUFFER to the CNT blocks starting at BLOCK_ID in a
+   single device request per DIRECT_MAX_SECTORS blocks, without
+   caching them.  Cached copies are updated too and marked clean,
+   so that they can neither be read stale nor written back over
+   the new data, and held until the write completes.  A block
+   that is read into the cache while the device works may miss
+   the new data, so it is invalidated afterward unless it has
+   been written since.  A user BUFFER goes through a kernel
+   bounce buffer, as in buffer_cache_read_direct(). */
+static void buffer_cache_write_direct(block_sector_t block_id, size_t cnt, const void* buffer_) {
+  const uint8_t* buffer = buffer_;
+
+  if (!is_kernel_vaddr(buffer)) {
+    uint8_t sector[BLOCK_SECTOR_SIZE];
+    size_t bounce_cnt;
+    uint8_t* bounce = buffer_cache_bounce_get(cnt, sector, &bounce_cnt);
+    for (size_t i = 0; i < cnt; i += bounce_cnt) {
+      size_t n = cnt - i < bounce_cnt ? cnt - i : bounce_cnt;
+      memcpy(bounce, buffer + i * BLOCK_SECTOR_SIZE, n * BLOCK_SECTOR_SIZE);
+      buffer_cache_write_direct(block_id + i, n, bounce);
+    }
+    buffer_cache_bounce_put(bounce, sector, bounce_cnt);
+    return;
+  }
+
+  for (; cnt > DIRECT_MAX_SECTORS; cnt -= DIRECT_MAX_SECTORS) {
+    buffer_cache_write_direct(block_id, DIRECT_MAX_SECTORS, buffer);
+    block_id += DIRECT_MAX_SECTORS;
+    buffer += DIRECT_MAX_SECTORS * BLOCK_SECTOR_SIZE;
+  }
+
+  lock_acquire(&buffer_cache_lock);
+  uint64_t held = buffer_cache_hold_cached(block_id, cnt);
+  for (size_t i = 0; i < cnt; i++) {
+    if (held & ((uint64_t)1 << i)) {
+      struct buffer_cache_entry* bce = buffer_cache_lookup(block_id + i);
+      memcpy(bce->block, buffer + i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+      buffer_cache_clean(bce);
+    }
+  }
+  lock_release(&buffer_cache_lock);
+
+  block_write_multiple(fs_device, block_id, cnt, buffer);
+
+  lock_acquire(&buffer_cache_lock);
+  for (size_t i = 0; i < cnt; i++) {
+    struct buffer_cache_entry* bce = buffer_cache_lookup(block_id + i);
+    if (held & ((uint64_t)1 << i)) {
+      buffer_cache_release_locked(bce);
+      continue;
+    }
+    while (bce != NULL && bce->ref_cnt > 0) {
+      cond_wait(&bce->cond, &buffer_cache_lock);
+      bce = buffer_cache_lookup(block_id + i);
+    }
+    if (bce != NULL && !bce->dirty) {
+      bce->valid = false;
+      list_remove(&bce->elem);
+      list_push_back(&available_cache, &bce->elem);
+    }
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Moves BCE, which the caller holds, to the cold end of the LRU
+   list, so that it is the next to be evicted. */
+static void buffer_cache_demote(struct buffer_cache_entry* bce) {
+  lock_acquire(&buffer_cache_lock);
+  list_remove(&bce->elem);
+  list_push_back(&available_cache, &bce->elem);
+  lock_release(&buffer_cache_lock);
+}
+
+/* Moves block BLOCK_ID, if it is cached, to the cold end of the
+   LRU list. */
+static void buffer_cache_demote_block(block_sector_t block_id) {
+  lock_acquire(&buffer_cache_lock);
+  struct buffer_cache_entry* bce = buffer_cache_lookup(block_id);
+  if (bce != NULL) {
+    list_remove(&bce->elem);
+    list_push_back(&available_cache, &bce->elem);
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Drops block BLOCK_ID from the cache, if it is cached, without
+   writing it back, for a block that is no longer part of any
+   file.  Waits for its users first. */
+static void buffer_cache_discard(block_sector_t block_id) {
+  lock_acquire(&buffer_cache_lock);
+  struct buffer_cache_entry* bce = buffer_cache_lookup(block_id);
+  while (bce != NULL && bce->ref_cnt > 0) {
+    cond_wait(&bce->cond, &buffer_cache_lock);
+    bce = buffer_cache_lookup(block_id);
+  }
+  if (bce != NULL && !bce->journaled) {
+    buffer_cache_clean(bce);
+    bce->valid = false;
+    list_remove(&bce->elem);
+    list_push_back(&available_cache, &bce->elem);
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Detaches all of INODE's dirty blocks from it. They stay dirty
+   and are written back by eviction or a later flush. */
+static void buffer_cache_disown(struct inode* inode) {
+  lock_acquire(&buffer_cache_lock);
+  while (!list_empty(&inode->dirty_blocks)) {
+    struct list_elem* e = list_pop_front(&inode->dirty_blocks);
+    list_entry(e, struct buffer_cache_entry, dirty_elem)->owner = NULL;
+  }
+  lock_release(&buffer_cache_lock);
+}
+
+/* Adds metadata block BCE, acquired for writing, to the running
+   journal transaction. If the journal logs it, the block stays
+   pinned in the cache until its group commits. */
+void buffer_cache_log(struct buffer_cache_entry* bce) {
+  if (!bce->journaled && journal_log(bce->block_id)) {
+    lock_acquire(&buffer_cache_lock);
+    bce->journaled = true;
+    lock_release(&buffer_cache_lock);
+  }
+}
+
+/* Copies the cached contents of pinned block BLOCK_ID into BUFFER. */
+void buffer_cache_snapshot(block_sector_t block_id, void* buffer) {
+  struct buffer_cache_entry* bce = buffer_cache_acquire(block_id, false);
+  ASSERT(bce->journaled);
+  memcpy(buffer, bce->block, BLOCK_SECTOR_SIZE);
+  buffer_cache_release(bce);
+}
+
+/* Releases the journal's pin on block BLOCK_ID once its group has
+   committed, allowing it to be written back and evicted. */
+void buffer_cache_unpin(block_sector_t block_id) {
+  lock_acquire(&buffer_cache_lock);
+  struct buffer_cache_entry* bce = buffer_cache_lookup(block_id);
+  if (bce != NULL) {
+    bce->journaled = false;
+    if (bce->ref_cnt == 0)
+      cond_broadcast(&buffer_cache_freed, &buffer_cache_lock);
+  }
   lock_release(&buffer_cache_lock);
 }
 
 void buffer_cache_reset(void) {
   lock_acquire(&buffer_cache_lock);
-  buffer_cache_flush();
+  buffer_cache_flush_locked();
   buffer_cache_access_cnt = 0;
   buffer_cache_hit_cnt = 0;
   for (int i = 0; i < 64; i++) {
-    buffer_cache[i].valid = false;
+    if (!buffer_cache[i].journaled)
+      buffer_cache[i].valid = false;
   }
   lock_release(&buffer_cache_lock);
+  page_cache_reset();
 }
 
+/* Returns the fraction of buffer and page cache lookups since the
+   last reset that hit. */
 float buffer_cache_hit_rate(void) {
+  lock_acquire(&page_cache_lock);
+  int access_cnt = page_cache_access_cnt;
+  int hit_cnt = page_cache_hit_cnt;
+  lock_release(&page_cache_lock);
+
   lock_acquire(&buffer_cache_lock);
-  float hit_rate = (float)buffer_cache_hit_cnt / buffer_cache_access_cnt;
+  access_cnt += buffer_cache_access_cnt;
+  hit_cnt += buffer_cache_hit_cnt;
   lock_release(&buffer_cache_lock);
-  return hit_rate;
-}
\ No newline at end of file
+  return (float)hit_cnt / access_cnt;
+}
+
+/* Allocates the page cache's first pages and installs its
+   shrinker. */
+static void page_cache_init(void) {
+  for (int i = 0; i < PAGE_CACHE_BUCKETS; i++)
+    list_init(&page_cache_buckets[i]);
+  list_init(&page_cache_lru);
+  list_init(&page_cache_spare);
+  lock_init(&page_cache_lock);
+  cond_init(&page_cache_cond);
+  page_cache_cnt = 0;
+  page_cache_access_cnt = 0;
+  page_cache_hit_cnt = 0;
+
+  for (int i = 0; i < PAGE_CACHE_MIN; i++) {
+    struct page_cache_entry* pce = malloc(sizeof *pce);
+    if (pce == NULL)
+      PANIC("page cache allocation failed");
+    pce->kpage = palloc_get_page(PAL_ASSERT);
+    pce->valid = false;
+    pce->loading = false;
+    pce->ref_cnt = 0;
+    list_push_back(&page_cache_lru, &pce->elem);
+    page_cache_cnt++;
+  }
+  palloc_set_shrinker(page_cache_shrink);
+}
+
+/* Returns the bucket for page PAGE_IDX of the file whose inode is
+   in sector INUMBER. */
+static struct list* page_cache_bucket(block_sector_t inumber, size_t page_idx) {
+  return &page_cache_buckets[(inumber * 31 + page_idx) % PAGE_CACHE_BUCKETS];
+}
+
+/* Returns the valid entry for page PAGE_IDX of the file whose
+   inode is in sector INUMBER, or NULL if the page is not cached.
+   Page cache lock must be held. */
+static struct page_cache_entry* page_cache_lookup(block_sector_t inumber, size_t page_idx) {
+  struct list* bucket = page_cache_bucket(inumber, page_idx);
+  for (struct list_elem* e = list_begin(bucket); e != list_end(bucket); e = list_next(e)) {
+    struct page_cache_entry* pce = list_entry(e, struct page_cache_entry, bucket_elem);
+    if (pce->inumber == inumber && pce->page_idx == page_idx)
+      return pce;
+  }
+  return NULL;
+}
+
+/* Marks PCE as holding no page and moves it to the cold end of
+   the LRU list, to be reused first.  Page cache lock must be
+   held. */
+static void page_cache_drop(struct page_cache_entry* pce) {
+  if (pce->valid) {
+    list_remove(&pce->bucket_elem);
+    pce->valid = false;
+  }
+  list_remove(&pce->elem);
+  list_push_back(&page_cache_lru, &pce->elem);
+}
+
+/* Adds an entry with a free kernel page to the cold end of the LRU
+   list, without calling the shrinker, since that would only evict
+   another page.  Returns false if the cache is at its largest or
+   no page is free beyond the reserve.  Page cache lock must be
+   held. */
+static bool page_cache_grow(void) {
+  if (page_cache_cnt >= PAGE_CACHE_MAX || palloc_free_cnt(0) <= PAGE_CACHE_RESERVE)
+    return false;
+
+  struct page_cache_entry* pce;
+  if (!list_empty(&page_cache_spare))
+    pce = list_entry(list_pop_front(&page_cache_spare), struct page_cache_entry, elem);
+  else if ((pce = malloc(sizeof *pce)) == NULL)
+    return false;
+
+  pce->kpage = palloc_get_page(PAL_NOSHRINK);
+  if (pce->kpage == NULL) {
+    list_push_front(&page_cache_spare, &pce->elem);
+    return false;
+  }
+  pce->valid = false;
+  pce->loading = false;
+  pce->ref_cnt = 0;
+  list_push_back(&page_cache_lru, &pce->elem);
+  page_cache_cnt++;
+  return true;
+}
+
+/* Gives back the pages of up to PAGE_CNT of the least recently
+   used entries not in use, keeping at least PAGE_CACHE_MIN, and
+   returns how many were freed.  The entries themselves are kept
+   as spares, because freeing them could reenter malloc.  Page
+   cache lock must be held. */
+static size_t page_cache_shrink_locked(size_t page_cnt) {
+  size_t freed_cnt = 0;
+  struct list_elem* e = list_rbegin(&page_cache_lru);
+  while (freed_cnt < page_cnt && page_cache_cnt > PAGE_CACHE_MIN &&
+         e != list_rend(&page_cache_lru)) {
+    struct page_cache_entry* pce = list_entry(e, struct page_cache_entry, elem);
+    e = list_prev(e);
+    if (pce->ref_cnt > 0)
+      continue;
+
+    if (pce->valid)
+      list_remove(&pce->bucket_elem);
+    list_remove(&pce->elem);
+    palloc_free_page(pce->kpage);
+    pce->kpage = NULL;
+    pce->valid = false;
+    list_push_back(&page_cache_spare, &pce->elem);
+    page_cache_cnt--;
+    freed_cnt++;
+  }
+  return freed_cnt;
+}
+
+/* Shrinker for palloc, called when the kernel pool runs out,
+   possibly while the caller holds other locks, including the page
+   cache's own, so it never waits for a lock.  Misses keep the
+   reserve whole, so this is only a last resort. */
+static size_t page_cache_shrink(size_t page_cnt) {
+  if (lock_held_by_current_thread(&page_cache_lock) || !lock_try_acquire(&page_cache_lock))
+    return 0;
+  size_t freed_cnt = page_cache_shrink_locked(page_cnt);
+  lock_release(&page_cache_lock);
+  return freed_cnt;
+}
+
+/* Reads page PAGE_IDX of INODE into KPAGE, with zeros past the
+   end of the file.  Each run of the page's sectors that lies in
+   consecutive sectors on disk is read in one request, so a page
+   of an unfragmented file costs one.  INODE's map lock must be
+   held. */
+static void page_cache_fill(struct inode* inode, size_t page_idx, uint8_t* kpage) {
+  off_t length = inode_length(inode);
+  off_t page_ofs = (off_t)page_idx * PGSIZE;
+  int sector_cnt = length > page_ofs ? bytes_to_sectors(length - page_ofs) : 0;
+  if (sector_cnt > PAGE_SECTORS)
+    sector_cnt = PAGE_SECTORS;
+
+  for (int i = 0; i < sector_cnt;) {
+    block_sector_t first = byte_to_sector(inode, page_ofs + i * BLOCK_SECTOR_SIZE);
+    int run_cnt = 1;
+    while (i + run_cnt < sector_cnt &&
+           byte_to_sector(inode, page_ofs + (i + run_cnt) * BLOCK_SECTOR_SIZE) == first + run_cnt)
+      run_cnt++;
+    buffer_cache_read_direct(first, run_cnt, kpage + i * BLOCK_SECTOR_SIZE);
+    i += run_cnt;
+  }
+  memset(kpage + sector_cnt * BLOCK_SECTOR_SIZE, 0,
+         (PAGE_SECTORS - sector_cnt) * BLOCK_SECTOR_SIZE);
+}
+
+/* Returns the entry holding page PAGE_IDX of INODE, a regular
+   file, reading it in if it is not cached, and keeps it from
+   being evicted until page_cache_release().  A miss first gives
+   back pages if free kernel pages have fallen below the reserve.
+   It then takes an unused entry, grows the cache if every unused
+   entry holds a page, and evicts the least recently used page
+   only if it cannot grow.  An entry is claimed before it is filled, so a
+   write that races with the fill either reaches the disk first or
+   updates the page after it loads.  If PREFETCH, a page that is
+   already cached is left alone and a null pointer returned, and
+   the lookup is not counted in the hit rate.  INODE's map lock
+   must be held. */
+static struct page_cache_entry* page_cache_get(struct inode* inode, size_t page_idx,
+                                               bool prefetch) {
+  lock_acquire(&page_cache_lock);
+  if (!prefetch)
+    page_cache_access_cnt++;
+
+  struct page_cache_entry* pce = page_cache_lookup(inode->sector, page_idx);
+  if (pce != NULL && prefetch) {
+    lock_release(&page_cache_lock);
+    return NULL;
+  } else if (pce != NULL) {
+    page_cache_hit_cnt++;
+    pce->ref_cnt++;
+    list_remove(&pce->elem);
+    list_push_front(&page_cache_lru, &pce->elem);
+    while (pce->loading)
+      cond_wait(&page_cache_cond, &page_cache_lock);
+    lock_release(&page_cache_lock);
+    return pce;
+  }
+
+  size_t free_cnt = palloc_free_cnt(0);
+  if (free_cnt < PAGE_CACHE_RESERVE)
+    page_cache_shrink_locked(PAGE_CACHE_RESERVE - free_cnt);
+
+  for (;;) {
+    /* Least recently used entry not in use. */
+    pce = NULL;
+    for (struct list_elem* e = list_rbegin(&page_cache_lru); e != list_rend(&page_cache_lru);
+         e = list_prev(e)) {
+      struct page_cache_entry* candidate = list_entry(e, struct page_cache_entry, elem);
+      if (candidate->ref_cnt == 0) {
+        pce = candidate;
+        break;
+      }
+    }
+
+    if (pce != NULL && !pce->valid)
+      break;
+    if (page_cache_grow())
+      continue;
+    if (pce != NULL)
+      break;
+    cond_wait(&page_cache_cond, &page_cache_lock);
+  }
+  if (pce->valid)
+    list_remove(&pce->bucket_elem);
+  pce->inumber = inode->sector;
+  pce->page_idx = page_idx;
+  pce->valid = true;
+  pce->loading = true;
+  pce->ref_cnt = 1;
+  list_push_back(page_cache_bucket(inode->sector, page_idx), &pce->bucket_elem);
+  list_remove(&pce->elem);
+  list_push_front(&page_cache_lru, &pce->elem);
+  lock_release(&page_cache_lock);
+
+  page_cache_fill(inode, page_idx, pce->kpage);
+
+  lock_acquire(&page_cache_lock);
+  pce->loading = false;
+  cond_broadcast(&page_cache_cond, &page_cache_lock);
+  lock_release(&page_cache_lock);
+  return pce;
+}
+
+/* Returns the entry holding page PAGE_IDX of INODE, a regular
+   file, as by page_cache_get(). */
+static struct page_cache_entry* page_cache_acquire(struct inode* inode, size_t page_idx) {
+  return page_cache_get(inode, page_idx, false);
+}
+
+/* Reads page PAGE_IDX of INODE, a regular file, into the page
+   cache ahead of its use, unless it is cached already.  If it is
+   read, returns the entry, which the caller must release.
+   Otherwise, returns a null pointer.  INODE's map lock must be
+   held. */
+static struct page_cache_entry* page_cache_prefetch(struct inode* inode, size_t page_idx) {
+  return page_cache_get(inode, page_idx, true);
+}
+
+/* Releases PCE, acquired with page_cache_acquire(). */
+static void page_cache_release(struct page_cache_entry* pce) {
+  lock_acquire(&page_cache_lock);
+  pce->ref_cnt--;
+  cond_broadcast(&page_cache_cond, &page_cache_lock);
+  lock_release(&page_cache_lock);
+}
+
+/* Copies the SIZE bytes in BUFFER, just written at OFFSET in
+   INODE, into the cached pages that hold them.  INODE's map lock
+   must be held. */
+static void page_cache_update(struct inode* inode, const uint8_t* buffer, off_t size,
+                              off_t offset) {
+  if (size <= 0)
+    return;
+
+  lock_acquire(&page_cache_lock);
+  for (size_t idx = offset / PGSIZE; idx <= (size_t)(offset + size - 1) / PGSIZE; idx++) {
+    struct page_cache_entry* pce = page_cache_lookup(inode->sector, idx);
+    if (pce == NULL)
+      continue;
+
+    /* A page still loading may have read the old data. */
+    pce->ref_cnt++;
+    while (pce->loading)
+      cond_wait(&page_cache_cond, &page_cache_lock);
+    pce->ref_cnt--;
+
+    off_t page_start = (off_t)idx * PGSIZE;
+    off_t start = offset > page_start ? offset : page_start;
+    off_t end = offset + size < page_start + PGSIZE ? offset + size : page_start + PGSIZE;
+    memcpy(pce->kpage + (start - page_start), buffer + (start - offset), end - start);
+  }
+  lock_release(&page_cache_lock);
+}
+
+/* Drops the cached pages, from page FIRST_IDX on, of the file
+   whose inode is in sector INUMBER, as when it is truncated or
+   deleted. */
+static void page_cache_invalidate(block_sector_t inumber, size_t first_idx) {
+  lock_acquire(&page_cache_lock);
+  struct list_elem* e = list_begin(&page_cache_lru);
+  while (e != list_end(&page_cache_lru)) {
+    struct page_cache_entry* pce = list_entry(e, struct page_cache_entry, elem);
+    e = list_next(e);
+    if (pce->valid && pce->inumber == inumber && pce->page_idx >= first_idx)
+      page_cache_drop(pce);
+  }
+  lock_release(&page_cache_lock);
+}
+
+/* Empties the page cache and clears its statistics. */
+static void page_cache_reset(void) {
+  lock_acquire(&page_cache_lock);
+  struct list_elem* e = list_begin(&page_cache_lru);
+  while (e != list_end(&page_cache_lru)) {
+    struct page_cache_entry* pce = list_entry(e, struct page_cache_entry, elem);
+    e = list_next(e);
+    if (pce->ref_cnt == 0)
+      page_cache_drop(pce);
+  }
+  page_cache_access_cnt = 0;
+  page_cache_hit_cnt = 0;
+  lock_release(&page_cache_lock);
+}
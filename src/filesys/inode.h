@@ -7,21 +7,56 @@
 
 struct bitmap;
 
+/* Sector number of inodes that are not stored on the file system
+   device. */
+#define INODE_NO_SECTOR ((block_sector_t)-1)
+
+/* Operations on the inodes of a mounted file system other than
+   the one on the file system device.  AUX is the value passed to
+   inode_open_ops(). */
+struct inode_operations {
+  off_t (*read_at)(void* aux, void* buffer, off_t size, off_t offset);
+  off_t (*write_at)(void* aux, const void* buffer, off_t size, off_t offset);
+  off_t (*length)(void* aux);
+  void (*close)(void* aux); /* Called on the last close. */
+};
+
+/* Access pattern hints for inode_advise(). */
+enum inode_advice {
+  ADVICE_NORMAL,     /* No particular pattern. */
+  ADVICE_SEQUENTIAL, /* Read sequentially. */
+  ADVICE_RANDOM,     /* Read randomly. */
+  ADVICE_WILLNEED,   /* Will be read soon. */
+  ADVICE_DONTNEED,   /* Will not be read soon. */
+  ADVICE_NOREUSE     /* Will be read once. */
+};
+
 void inode_init(void);
-bool inode_create(block_sector_t, off_t);
+bool inode_create(block_sector_t, off_t, bool is_dir);
 struct inode* inode_open(block_sector_t);
+struct inode* inode_open_ops(const struct inode_operations*, void* aux);
 struct inode* inode_reopen(struct inode*);
 block_sector_t inode_get_inumber(const struct inode*);
 void inode_close(struct inode*);
 void inode_remove(struct inode*);
+bool inode_is_removed(struct inode*);
 off_t inode_read_at(struct inode*, void*, off_t size, off_t offset);
 off_t inode_write_at(struct inode*, const void*, off_t size, off_t offset);
+off_t inode_read_at_direct(struct inode*, void*, off_t size, off_t offset);
+off_t inode_write_at_direct(struct inode*, const void*, off_t size, off_t offset);
+bool inode_truncate(struct inode*, off_t length);
+bool inode_allocate(struct inode*, off_t offset, off_t len);
 void inode_deny_write(struct inode*);
 void inode_allow_write(struct inode*);
 off_t inode_length(const struct inode*);
 void inode_set_isdir(struct inode* inode, bool value);
 bool inode_isdir(struct inode* inode);
 int inode_open_cnt(struct inode* inode);
+void inode_lock_dir(struct inode* inode, bool reader);
+void inode_unlock_dir(struct inode* inode, bool reader);
+void inode_sync(struct inode* inode, bool data_only);
+int inode_defrag(struct inode* inode);
+void inode_advise(struct inode* inode, enum inode_advice advice, off_t pos);
 
 /* Buffer cache. */
 void buffer_cache_init(void);
@@ -29,6 +64,10 @@ void buffer_cache_done(void);
 void buffer_cache_flush(void);
 struct buffer_cache_entry* buffer_cache_acquire(block_sector_t block_id, bool write);
 void buffer_cache_release(struct buffer_cache_entry* bce);
+void buffer_cache_dirty(struct buffer_cache_entry* bce, struct inode* owner);
+void buffer_cache_log(struct buffer_cache_entry* bce);
+void buffer_cache_snapshot(block_sector_t block_id, void* buffer);
+void buffer_cache_unpin(block_sector_t block_id);
 void buffer_cache_reset(void);
 float buffer_cache_hit_rate(void);
 
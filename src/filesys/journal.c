@@ -0,0 +1,492 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead metadata journal.
+
+   Every file system operation that updates metadata (inodes,
+   pointer blocks, directories and the free map) runs as a
+   transaction between journal_begin() and journal_end().  The
+   sectors it modifies are pinned in the buffer cache and
+   collected into the running group.  Several transactions share
+   one group, which is committed by appending a descriptor block,
+   the sector images and a commit block to the log in a single
+   multi-sector write.  Committed sectors are then written back to
+   their home locations lazily, whenever the buffer cache evicts
+   or flushes them; the log is only checkpointed when it fills up.
+   The disk's write cache is flushed once per commit and once per
+   checkpoint, before the log header empties the log.
+
+   Sectors that a transaction frees stay allocated until its group
+   commits, so that no other file can take them and overwrite
+   their contents while a crash could still bring back the
+   metadata that points to them.  Once the group is durable, they
+   are returned to the free map in transactions of their own; a
+   crash in between leaks them.
+
+   At mount time, the committed groups still in the log are
+   replayed in order, so recovery never has to scan the rest of
+   the file system. */
+
+/* Identify the journal header, descriptor and commit blocks. */
+#define JOURNAL_MAGIC 0x4a524e4c
+#define JOURNAL_DESC_MAGIC 0x4a444553
+#define JOURNAL_COMMIT_MAGIC 0x4a434d54
+
+/* Most sectors a group may pin in the buffer cache.  Must stay
+   well below the number of cache entries, so that eviction can
+   always find an unpinned victim.  Every running transaction
+   reserves JOURNAL_TXN_BLOCKS of them when it begins, so a group
+   never runs out of room. */
+#define JOURNAL_MAX_BLOCKS 48
+
+/* A group is committed once it holds this many sectors, or once
+   its first update is this many timer ticks old. */
+#define JOURNAL_GROUP_BLOCKS 32
+#define JOURNAL_GROUP_TICKS (5 * TIMER_FREQ)
+
+/* On-disk journal header, stored in JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header {
+  unsigned magic;       /* Magic number. */
+  block_sector_t start; /* First sector of the log. */
+  block_sector_t size;  /* Number of sectors in the log. */
+  uint32_t seq;         /* Sequence number of the first group in the log. */
+  uint8_t unused[496];  /* Not used. */
+};
+
+/* First sector of every group in the log.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+#define JOURNAL_DESC_CNT 125
+struct journal_desc {
+  unsigned magic;                           /* Magic number. */
+  uint32_t seq;                             /* Group sequence number. */
+  uint32_t cnt;                             /* Number of logged sectors. */
+  block_sector_t sectors[JOURNAL_DESC_CNT]; /* Home location of each logged sector. */
+};
+
+/* Last sector of every group in the log.  A group counts as
+   committed only if its commit block is present and its checksum
+   matches the logged sector images.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_commit {
+  unsigned magic;      /* Magic number. */
+  uint32_t seq;        /* Group sequence number. */
+  uint32_t cnt;        /* Number of logged sectors. */
+  uint32_t checksum;   /* Checksum of the logged sector images. */
+  uint8_t unused[496]; /* Not used. */
+};
+
+static struct journal_header header; /* Copy of the on-disk header. */
+static bool enabled;                  /* Are metadata updates being logged? */
+static block_sector_t head;           /* Next free sector in the log. */
+static uint32_t next_seq;             /* Sequence number of the running group. */
+
+/* The running group: sectors modified by transactions that have
+   not been committed yet. */
+static block_sector_t group[JOURNAL_MAX_BLOCKS];
+static size_t group_cnt;
+static int64_t group_start; /* Timer tick of the group's first update. */
+
+/* A growable array of sectors. */
+struct sector_list {
+  block_sector_t* sectors; /* Sectors. */
+  size_t cnt;              /* Number of sectors in SECTORS. */
+  size_t cap;              /* Capacity of SECTORS. */
+};
+
+/* Sectors freed by the running group, and sectors freed by
+   committed groups that have yet to be returned to the free
+   map. */
+static struct sector_list pending_frees;
+static struct sector_list committed_frees;
+static bool releasing; /* Is a thread returning committed frees? */
+
+static int active_cnt;           /* Number of running top-level transactions. */
+static struct lock journal_lock; /* Synchronizes the journal state above. */
+static struct condition ended;   /* Signaled when a top-level transaction ends. */
+
+/* Staging area for a group: descriptor, sector images, commit block. */
+static uint8_t log_buffer[(JOURNAL_MAX_BLOCKS + 2) * BLOCK_SECTOR_SIZE];
+
+/* Checksums. */
+#define CHECKSUM_INIT 2166136261u
+
+/* Folds SIZE bytes of BUF into HASH (32-bit FNV-1a) and returns
+   the result. */
+static uint32_t checksum(uint32_t hash, const void* buf_, size_t size) {
+  const uint8_t* buf = buf_;
+  while (size-- > 0)
+    hash = (hash ^ *buf++) * 16777619u;
+  return hash;
+}
+
+/* Initializes the journal module.  Updates are not logged until
+   journal_open() is called. */
+void journal_init(void) {
+  lock_init(&journal_lock);
+  cond_init(&ended);
+  enabled = false;
+  group_cnt = 0;
+  active_cnt = 0;
+  releasing = false;
+}
+
+/* Reserves the log on a freshly formatted file system device and
+   writes an empty journal header. */
+void journal_create(void) {
+  static uint8_t zeros[BLOCK_SECTOR_SIZE];
+  block_sector_t start;
+
+  ASSERT(sizeof header == BLOCK_SECTOR_SIZE);
+  ASSERT(sizeof(struct journal_desc) == BLOCK_SECTOR_SIZE);
+  ASSERT(sizeof(struct journal_commit) == BLOCK_SECTOR_SIZE);
+
+  if (!free_map_allocate(JOURNAL_SECTORS, &start))
+    PANIC("journal creation failed");
+
+  /* Clear the first log sector, so that a log left behind by a
+     previous file system on this device is never replayed. */
+  block_write(fs_device, start, zeros);
+
+  memset(&header, 0, sizeof header);
+  header.magic = JOURNAL_MAGIC;
+  header.start = start;
+  header.size = JOURNAL_SECTORS;
+  header.seq = 1;
+  block_write(fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Replays the committed groups in the log, oldest first, and
+   returns the number of groups replayed. */
+static int replay_log(void) {
+  static uint8_t image[BLOCK_SECTOR_SIZE];
+  struct journal_desc* desc = (struct journal_desc*)log_buffer;
+  struct journal_commit* commit = (struct journal_commit*)(log_buffer + BLOCK_SECTOR_SIZE);
+  block_sector_t end = header.start + header.size;
+  block_sector_t pos = header.start;
+  int replayed = 0;
+
+  while (pos + 2 <= end) {
+    uint32_t seq = header.seq + replayed;
+    uint32_t sum = CHECKSUM_INIT;
+    size_t i;
+
+    /* Find a complete group with the expected sequence number. */
+    block_read(fs_device, pos, desc);
+    if (desc->magic != JOURNAL_DESC_MAGIC || desc->seq != seq || desc->cnt > JOURNAL_DESC_CNT ||
+        pos + desc->cnt + 2 > end)
+      break;
+    block_read(fs_device, pos + desc->cnt + 1, commit);
+    if (commit->magic != JOURNAL_COMMIT_MAGIC || commit->seq != seq || commit->cnt != desc->cnt)
+      break;
+
+    /* Verify every image before writing any of them home, so
+       that a torn group is never half applied. */
+    for (i = 0; i < desc->cnt; i++) {
+      block_read(fs_device, pos + 1 + i, image);
+      sum = checksum(sum, image, BLOCK_SECTOR_SIZE);
+    }
+    if (sum != commit->checksum)
+      break;
+
+    for (i = 0; i < desc->cnt; i++) {
+      block_read(fs_device, pos + 1 + i, image);
+      block_write(fs_device, desc->sectors[i], image);
+    }
+
+    pos += desc->cnt + 2;
+    replayed++;
+  }
+
+  return replayed;
+}
+
+/* Reads the journal header, replays any groups committed before
+   the last shutdown and starts logging metadata updates.  Must
+   be called before anything else reads the file system. */
+void journal_open(void) {
+  int replayed;
+
+  block_read(fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC) {
+    printf("journal: no journal found, metadata updates will not be logged\n");
+    return;
+  }
+
+  replayed = replay_log();
+  if (replayed > 0) {
+    printf("journal: replayed %d committed group(s)\n", replayed);
+    header.seq += replayed;
+    block_write(fs_device, JOURNAL_SECTOR, &header);
+  }
+
+  head = header.start;
+  next_seq = header.seq;
+  enabled = true;
+}
+
+/* Appends CNT sectors from SECTORS to LIST.  Returns false if
+   memory runs out, in which case LIST is unchanged. */
+static bool sector_list_append(struct sector_list* list, const block_sector_t* sectors,
+                               size_t cnt) {
+  if (list->cnt + cnt > list->cap) {
+    size_t cap = list->cap ? 2 * list->cap : 64;
+    while (cap < list->cnt + cnt)
+      cap *= 2;
+    block_sector_t* grown = realloc(list->sectors, cap * sizeof *grown);
+    if (grown == NULL)
+      return false;
+    list->sectors = grown;
+    list->cap = cap;
+  }
+  memcpy(list->sectors + list->cnt, sectors, cnt * sizeof *sectors);
+  list->cnt += cnt;
+  return true;
+}
+
+/* Writes every committed update to its home location and empties
+   the log.  Sectors pinned by the running group stay in the
+   buffer cache. */
+static void checkpoint_log(void) {
+  buffer_cache_flush();
+  block_flush(fs_device);
+  header.seq = next_seq;
+  block_write(fs_device, JOURNAL_SECTOR, &header);
+  head = header.start;
+}
+
+/* Hands the sectors freed by the running group, which must just
+   have committed, over to be returned to the free map.  If there
+   is no memory to do so, they wait for the next commit, which
+   covers them just as well.  Must be called with the journal lock
+   held. */
+static void hand_over_frees(void) {
+  if (pending_frees.cnt == 0)
+    return;
+  if (committed_frees.cnt == 0) {
+    struct sector_list empty = {NULL, 0, 0};
+    free(committed_frees.sectors);
+    committed_frees = pending_frees;
+    pending_frees = empty;
+  } else if (sector_list_append(&committed_frees, pending_frees.sectors, pending_frees.cnt))
+    pending_frees.cnt = 0;
+}
+
+/* Appends the running group to the log and unpins its sectors.
+   Must be called with the journal lock held and no transaction
+   running. */
+static void commit_group(void) {
+  struct journal_desc* desc = (struct journal_desc*)log_buffer;
+  struct journal_commit* commit;
+  size_t log_cnt = group_cnt + 2;
+  uint32_t sum = CHECKSUM_INIT;
+  size_t i;
+
+  ASSERT(lock_held_by_current_thread(&journal_lock));
+  ASSERT(active_cnt == 0);
+
+  /* A group that logged nothing only freed sectors that earlier,
+     committed groups stopped using. */
+  if (group_cnt == 0) {
+    hand_over_frees();
+    return;
+  }
+
+  /* Make room by checkpointing if the group does not fit. */
+  if (head + log_cnt > header.start + header.size)
+    checkpoint_log();
+
+  /* Stage descriptor, sector images and commit block. */
+  memset(desc, 0, BLOCK_SECTOR_SIZE);
+  desc->magic = JOURNAL_DESC_MAGIC;
+  desc->seq = next_seq;
+  desc->cnt = group_cnt;
+  for (i = 0; i < group_cnt; i++) {
+    uint8_t* image = log_buffer + (i + 1) * BLOCK_SECTOR_SIZE;
+    desc->sectors[i] = group[i];
+    buffer_cache_snapshot(group[i], image);
+    sum = checksum(sum, image, BLOCK_SECTOR_SIZE);
+  }
+  commit = (struct journal_commit*)(log_buffer + (group_cnt + 1) * BLOCK_SECTOR_SIZE);
+  memset(commit, 0, BLOCK_SECTOR_SIZE);
+  commit->magic = JOURNAL_COMMIT_MAGIC;
+  commit->seq = next_seq;
+  commit->cnt = group_cnt;
+  commit->checksum = sum;
+
+  /* Append the whole group to the log in a single request, and
+     make sure it is on the media, not in the disk's cache, before
+     any of its sectors can be written home. */
+  block_write_multiple(fs_device, head, log_cnt, log_buffer);
+  block_flush(fs_device);
+
+  /* The group is durable, so its sectors may now be written home
+     whenever the buffer cache gets to them. */
+  for (i = 0; i < group_cnt; i++)
+    buffer_cache_unpin(group[i]);
+
+  head += log_cnt;
+  next_seq++;
+  group_cnt = 0;
+  hand_over_frees();
+}
+
+/* Returns the sectors freed by committed groups to the free map,
+   unless another thread is already doing so.  Must be called
+   outside of any transaction, since the free map is updated in
+   transactions of its own. */
+static void release_committed(void) {
+  ASSERT(thread_current()->journal_depth == 0);
+
+  lock_acquire(&journal_lock);
+  while (!releasing && committed_frees.cnt > 0) {
+    struct sector_list frees = committed_frees;
+    struct sector_list empty = {NULL, 0, 0};
+    committed_frees = empty;
+    releasing = true;
+    lock_release(&journal_lock);
+
+    free_map_release_committed(frees.sectors, frees.cnt);
+    free(frees.sectors);
+
+    lock_acquire(&journal_lock);
+    releasing = false;
+  }
+  lock_release(&journal_lock);
+}
+
+/* Commits the running group and checkpoints the log, so that the
+   next mount finds nothing to replay. */
+void journal_close(void) {
+  lock_acquire(&journal_lock);
+  while (active_cnt > 0)
+    cond_wait(&ended, &journal_lock);
+  if (enabled) {
+    commit_group();
+    lock_release(&journal_lock);
+    release_committed();
+    lock_acquire(&journal_lock);
+    while (active_cnt > 0)
+      cond_wait(&ended, &journal_lock);
+    commit_group();
+    checkpoint_log();
+    enabled = false;
+  }
+  lock_release(&journal_lock);
+}
+
+/* Returns true if the running group should be committed before
+   it grows any further. */
+static bool group_full(void) { return group_cnt >= JOURNAL_GROUP_BLOCKS; }
+
+/* Returns true if the running group has room for one more
+   transaction's reservation, on top of those of the running
+   transactions. */
+static bool group_has_room(void) {
+  return group_cnt + (active_cnt + 1) * JOURNAL_TXN_BLOCKS <= JOURNAL_MAX_BLOCKS;
+}
+
+/* Starts a transaction.  Transactions nest: only the outermost
+   journal_begin()/journal_end() pair of a thread counts.  Waits
+   for the running group to commit first if it is full, or for
+   running transactions to end if the group has no room for this
+   one to log JOURNAL_TXN_BLOCKS sectors. */
+void journal_begin(void) {
+  struct thread* t = thread_current();
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  lock_acquire(&journal_lock);
+  while (group_full() || !group_has_room()) {
+    if (active_cnt == 0)
+      commit_group();
+    else
+      cond_wait(&ended, &journal_lock);
+  }
+  active_cnt++;
+  lock_release(&journal_lock);
+}
+
+/* Ends a transaction started by journal_begin().  The last
+   transaction to leave a full or old group commits it, as well as
+   a group that only freed sectors.  Then returns the sectors that
+   committed groups freed to the free map, if there are any. */
+void journal_end(void) {
+  struct thread* t = thread_current();
+
+  ASSERT(t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire(&journal_lock);
+  if (--active_cnt == 0 &&
+      (group_full() || group_cnt == 0 || timer_elapsed(group_start) >= JOURNAL_GROUP_TICKS))
+    commit_group();
+  cond_broadcast(&ended, &journal_lock);
+  bool release = !releasing && committed_frees.cnt > 0;
+  lock_release(&journal_lock);
+
+  if (release)
+    release_committed();
+}
+
+/* Adds SECTOR, which the running transaction has just modified in
+   the buffer cache, to the running group.  Returns true if the
+   update is logged, in which case the buffer cache must not write
+   SECTOR home until the group commits.  Returns false if the
+   journal is off or no transaction is running.  Panics if the
+   group has no room left, which means that some transaction
+   logged more than the JOURNAL_TXN_BLOCKS it reserved. */
+bool journal_log(block_sector_t sector) {
+  if (!enabled || thread_current()->journal_depth == 0)
+    return false;
+
+  lock_acquire(&journal_lock);
+  if (group_cnt == JOURNAL_MAX_BLOCKS)
+    PANIC("journal: transaction too large");
+  if (group_cnt == 0)
+    group_start = timer_ticks();
+  group[group_cnt++] = sector;
+  lock_release(&journal_lock);
+  return true;
+}
+
+/* Queues SECTOR, which the running transaction no longer uses, to
+   be returned to the free map once the running group commits.
+   Returns false if the journal is off, no transaction is running
+   or memory runs out, in which case the caller should free SECTOR
+   at once. */
+bool journal_free(block_sector_t sector) {
+  if (!enabled || thread_current()->journal_depth == 0)
+    return false;
+
+  lock_acquire(&journal_lock);
+  bool success = sector_list_append(&pending_frees, &sector, 1);
+  lock_release(&journal_lock);
+  return success;
+}
+
+/* Commits the running group, waiting for running transactions to
+   finish first, and returns the sectors it freed to the free map.
+   The caller must not be inside a transaction. */
+void journal_commit(void) {
+  ASSERT(thread_current()->journal_depth == 0);
+
+  lock_acquire(&journal_lock);
+  while (active_cnt > 0)
+    cond_wait(&ended, &journal_lock);
+  commit_group();
+  lock_release(&journal_lock);
+  release_committed();
+}
@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Number of sectors reserved for the metadata log at format time. */
+#define JOURNAL_SECTORS 128
+
+/* Most sectors one top-level transaction may log.  Operations
+   that could log more, such as growing a file by a large amount,
+   are split into several transactions. */
+#define JOURNAL_TXN_BLOCKS 16
+
+void journal_init(void);
+void journal_create(void);
+void journal_open(void);
+void journal_close(void);
+
+/* Transactions. */
+void journal_begin(void);
+void journal_end(void);
+bool journal_log(block_sector_t);
+bool journal_free(block_sector_t);
+void journal_commit(void);
+
+#endif /* filesys/journal.h */
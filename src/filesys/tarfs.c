@@ -0,0 +1,217 @@
+#include "filesys/tarfs.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <ustar.h>
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Read-only file system backed by a ustar archive.
+
+   The archive, as written to the scratch disk by the `pintos'
+   utility's -p option, is indexed once at mount time.  Files are
+   then read straight from the sectors of the archive, so programs
+   can be run without first extracting them into the disk file
+   system.  Directory entries in the archive are ignored; a file
+   stored as "a/b" is opened by that name below the mount point. */
+
+/* A regular file in the archive. */
+struct tarfs_file {
+  struct hash_elem elem; /* Element in tarfs_files. */
+  char* name;            /* Name in the archive. */
+  block_sector_t start;  /* First sector of the file's data. */
+  off_t length;          /* File size in bytes. */
+};
+
+/* Most pages of bounce buffer one read from the archive uses.
+   A longer read is split into requests of this size. */
+#define TARFS_READ_PAGES 16
+
+static struct block* tarfs_device; /* Block device holding the archive. */
+static struct hash tarfs_files;    /* Index of the archive's files. */
+
+static struct inode* tarfs_open(void* aux, const char* name);
+static off_t tarfs_read_at(void* file_, void* buffer, off_t size, off_t offset);
+static off_t tarfs_write_at(void* file_, const void* buffer, off_t size, off_t offset);
+static off_t tarfs_length(void* file_);
+static void tarfs_close(void* file_);
+
+static const struct mount_operations tarfs_mount_ops = {
+    .open = tarfs_open,
+};
+
+static const struct inode_operations tarfs_inode_ops = {
+    .read_at = tarfs_read_at,
+    .write_at = tarfs_write_at,
+    .length = tarfs_length,
+    .close = tarfs_close,
+};
+
+/* Returns a hash value for tarfs_file F. */
+static unsigned tarfs_hash(const struct hash_elem* f_, void* aux UNUSED) {
+  const struct tarfs_file* f = hash_entry(f_, struct tarfs_file, elem);
+  return hash_string(f->name);
+}
+
+/* Returns true if tarfs_file A's name precedes B's. */
+static bool tarfs_less(const struct hash_elem* a_, const struct hash_elem* b_, void* aux UNUSED) {
+  const struct tarfs_file* a = hash_entry(a_, struct tarfs_file, elem);
+  const struct tarfs_file* b = hash_entry(b_, struct tarfs_file, elem);
+  return strcmp(a->name, b->name) < 0;
+}
+
+/* Frees tarfs_file F. */
+static void tarfs_free_file(struct tarfs_file* f) {
+  free(f->name);
+  free(f);
+}
+
+/* Indexes the ustar archive on DEVICE and mounts it, read-only,
+   at PATH.  Returns true if successful, false if the archive is
+   malformed or memory runs out.  A file whose data would run past
+   the end of DEVICE, as in a truncated archive, is left out, along
+   with everything after it.  If the archive holds several files by
+   one name, the last one wins. */
+bool tarfs_mount(struct block* device, const char* path) {
+  char* header = malloc(BLOCK_SECTOR_SIZE);
+  block_sector_t sector = 0;
+  size_t file_cnt = 0;
+
+  if (header == NULL || !hash_init(&tarfs_files, tarfs_hash, tarfs_less, NULL)) {
+    free(header);
+    return false;
+  }
+  tarfs_device = device;
+
+  while (sector < block_size(device)) {
+    const char* name;
+    const char* error;
+    enum ustar_type type;
+    int size;
+
+    block_read(device, sector++, header);
+    error = ustar_parse_header(header, &name, &type, &size);
+    if (error != NULL) {
+      printf("tarfs: bad ustar header in sector %" PRDSNu " (%s)\n", sector - 1, error);
+      free(header);
+      return false;
+    }
+    if (type == USTAR_EOF)
+      break;
+    if (type != USTAR_REGULAR)
+      continue;
+    if ((block_sector_t)DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE) > block_size(device) - sector) {
+      printf("tarfs: \"%s\" runs past the end of %s, ignoring it\n", name, block_name(device));
+      break;
+    }
+
+    struct tarfs_file* f = malloc(sizeof *f);
+    char* name_copy = malloc(strlen(name) + 1);
+    if (f == NULL || name_copy == NULL) {
+      free(f);
+      free(name_copy);
+      free(header);
+      return false;
+    }
+    strlcpy(name_copy, name, strlen(name) + 1);
+    f->name = name_copy;
+    f->start = sector;
+    f->length = size;
+    struct hash_elem* old = hash_replace(&tarfs_files, &f->elem);
+    if (old != NULL)
+      tarfs_free_file(hash_entry(old, struct tarfs_file, elem));
+    else
+      file_cnt++;
+
+    /* Skip over the file's data. */
+    sector += DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE);
+  }
+  free(header);
+
+  if (!filesys_mount(path, &tarfs_mount_ops, NULL))
+    return false;
+  printf("tarfs: mounted %zu files from %s at %s\n", file_cnt, block_name(device), path);
+  return true;
+}
+
+/* Opens the archive file named NAME. */
+static struct inode* tarfs_open(void* aux UNUSED, const char* name) {
+  struct tarfs_file key;
+  key.name = (char*)name;
+  struct hash_elem* e = hash_find(&tarfs_files, &key.elem);
+  if (e == NULL)
+    return NULL;
+  return inode_open_ops(&tarfs_inode_ops, hash_entry(e, struct tarfs_file, elem));
+}
+
+/* Reads SIZE bytes at OFFSET of archive file FILE_ into BUFFER,
+   directly from the archive's sectors.  The sectors are read
+   through a bounce buffer of up to TARFS_READ_PAGES pages, as one
+   multi-sector request per bounce buffer full. */
+static off_t tarfs_read_at(void* file_, void* buffer_, off_t size, off_t offset) {
+  struct tarfs_file* file = file_;
+  uint8_t* buffer = buffer_;
+  off_t bytes_read = 0;
+
+  if (offset >= file->length)
+    return 0;
+  if (size > file->length - offset)
+    size = file->length - offset;
+  if (size <= 0)
+    return 0;
+
+  /* Fall back to a single page if memory is short. */
+  size_t page_cnt = DIV_ROUND_UP(offset % BLOCK_SECTOR_SIZE + size, PGSIZE);
+  if (page_cnt > TARFS_READ_PAGES)
+    page_cnt = TARFS_READ_PAGES;
+  uint8_t* bounce = palloc_get_multiple(0, page_cnt);
+  if (bounce == NULL && page_cnt > 1) {
+    page_cnt = 1;
+    bounce = palloc_get_page(0);
+  }
+  if (bounce == NULL)
+    return 0;
+  size_t bounce_sectors = page_cnt * PGSIZE / BLOCK_SECTOR_SIZE;
+
+  while (size > 0) {
+    block_sector_t sector = file->start + offset / BLOCK_SECTOR_SIZE;
+    int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+    size_t cnt = DIV_ROUND_UP(sector_ofs + size, BLOCK_SECTOR_SIZE);
+    if (cnt > bounce_sectors)
+      cnt = bounce_sectors;
+    off_t chunk_size = cnt * BLOCK_SECTOR_SIZE - sector_ofs;
+    if (chunk_size > size)
+      chunk_size = size;
+
+    block_read_multiple(tarfs_device, sector, cnt, bounce);
+    memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    bytes_read += chunk_size;
+  }
+  palloc_free_multiple(bounce, page_cnt);
+
+  return bytes_read;
+}
+
+/* The archive is read-only. */
+static off_t tarfs_write_at(void* file_ UNUSED, const void* buffer UNUSED, off_t size UNUSED,
+                            off_t offset UNUSED) {
+  return 0;
+}
+
+/* Returns the length of archive file FILE_. */
+static off_t tarfs_length(void* file_) {
+  struct tarfs_file* file = file_;
+  return file->length;
+}
+
+/* The index outlives every open file, so there is nothing to
+   release. */
+static void tarfs_close(void* file_ UNUSED) {}
@@ -0,0 +1,9 @@
+#ifndef FILESYS_TARFS_H
+#define FILESYS_TARFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+bool tarfs_mount(struct block* device, const char* path);
+
+#endif /* filesys/tarfs.h */
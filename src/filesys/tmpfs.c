@@ -0,0 +1,219 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <list.h>
+#include <stddef.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Memory-backed file system for temporary files.
+
+   Each file is described by one page from palloc, which also
+   holds the table of its data pages.  Data pages are allocated on
+   first write, so holes read as zeros.  Nothing ever reaches the
+   file system device, and reads and writes cost a memcpy.  The
+   namespace is flat: names below the mount point may not contain
+   slashes.  Contents are lost at shutdown. */
+
+/* A file, stored in its own page. */
+struct tmpfs_file {
+  struct list_elem elem;   /* Element in tmpfs_files. */
+  char name[NAME_MAX + 1]; /* File name. */
+  off_t length;            /* File size in bytes. */
+  int open_cnt;            /* Number of open inodes for this file. */
+  bool removed;            /* Free once the last opener closes it? */
+  uint8_t* pages[];        /* Data pages, null where never written. */
+};
+
+/* Number of data pages a tmpfs_file has room for. */
+#define TMPFS_PAGE_CNT ((PGSIZE - offsetof(struct tmpfs_file, pages)) / sizeof(uint8_t*))
+
+/* Largest file size, in bytes. */
+#define TMPFS_MAX_LENGTH ((off_t)(TMPFS_PAGE_CNT * PGSIZE))
+
+static struct list tmpfs_files; /* All files not yet removed. */
+static struct lock tmpfs_lock;  /* Synchronizes all tmpfs state. */
+
+static struct inode* tmpfs_open(void* aux, const char* name);
+static bool tmpfs_create(void* aux, const char* name, off_t initial_size);
+static bool tmpfs_remove(void* aux, const char* name);
+static off_t tmpfs_read_at(void* file_, void* buffer, off_t size, off_t offset);
+static off_t tmpfs_write_at(void* file_, const void* buffer, off_t size, off_t offset);
+static off_t tmpfs_length(void* file_);
+static void tmpfs_close(void* file_);
+
+static const struct mount_operations tmpfs_mount_ops = {
+    .open = tmpfs_open,
+    .create = tmpfs_create,
+    .remove = tmpfs_remove,
+};
+
+static const struct inode_operations tmpfs_inode_ops = {
+    .read_at = tmpfs_read_at,
+    .write_at = tmpfs_write_at,
+    .length = tmpfs_length,
+    .close = tmpfs_close,
+};
+
+/* Initializes tmpfs and mounts it at PATH. */
+void tmpfs_init(const char* path) {
+  list_init(&tmpfs_files);
+  lock_init(&tmpfs_lock);
+  if (!filesys_mount(path, &tmpfs_mount_ops, NULL))
+    PANIC("couldn't mount tmpfs at %s", path);
+}
+
+/* Returns the file named NAME, or a null pointer if there is
+   none.  tmpfs_lock must be held. */
+static struct tmpfs_file* lookup(const char* name) {
+  for (struct list_elem* e = list_begin(&tmpfs_files); e != list_end(&tmpfs_files);
+       e = list_next(e)) {
+    struct tmpfs_file* f = list_entry(e, struct tmpfs_file, elem);
+    if (!strcmp(f->name, name))
+      return f;
+  }
+  return NULL;
+}
+
+/* Frees FILE and its data pages. */
+static void free_file(struct tmpfs_file* file) {
+  for (size_t i = 0; i < TMPFS_PAGE_CNT; i++)
+    if (file->pages[i] != NULL)
+      palloc_free_page(file->pages[i]);
+  palloc_free_page(file);
+}
+
+/* Creates a file named NAME of INITIAL_SIZE bytes, all zeros. */
+static bool tmpfs_create(void* aux UNUSED, const char* name, off_t initial_size) {
+  if (strlen(name) > NAME_MAX || strchr(name, '/') != NULL || initial_size < 0 ||
+      initial_size > TMPFS_MAX_LENGTH)
+    return false;
+
+  lock_acquire(&tmpfs_lock);
+  struct tmpfs_file* f = NULL;
+  if (lookup(name) == NULL)
+    f = palloc_get_page(PAL_ZERO);
+  if (f != NULL) {
+    strlcpy(f->name, name, sizeof f->name);
+    f->length = initial_size;
+    list_push_back(&tmpfs_files, &f->elem);
+  }
+  lock_release(&tmpfs_lock);
+  return f != NULL;
+}
+
+/* Opens the file named NAME.  Each open returns a new inode. */
+static struct inode* tmpfs_open(void* aux UNUSED, const char* name) {
+  struct inode* inode = NULL;
+
+  lock_acquire(&tmpfs_lock);
+  struct tmpfs_file* f = lookup(name);
+  if (f != NULL) {
+    inode = inode_open_ops(&tmpfs_inode_ops, f);
+    if (inode != NULL)
+      f->open_cnt++;
+  }
+  lock_release(&tmpfs_lock);
+  return inode;
+}
+
+/* Removes the file named NAME.  Its pages are freed once it is
+   no longer open. */
+static bool tmpfs_remove(void* aux UNUSED, const char* name) {
+  lock_acquire(&tmpfs_lock);
+  struct tmpfs_file* f = lookup(name);
+  if (f != NULL) {
+    list_remove(&f->elem);
+    if (f->open_cnt == 0)
+      free_file(f);
+    else
+      f->removed = true;
+  }
+  lock_release(&tmpfs_lock);
+  return f != NULL;
+}
+
+/* Reads SIZE bytes at OFFSET of FILE_ into BUFFER. */
+static off_t tmpfs_read_at(void* file_, void* buffer_, off_t size, off_t offset) {
+  struct tmpfs_file* file = file_;
+  uint8_t* buffer = buffer_;
+  off_t bytes_read = 0;
+
+  lock_acquire(&tmpfs_lock);
+  if (offset < file->length && size > file->length - offset)
+    size = file->length - offset;
+  while (size > 0 && offset < file->length) {
+    uint8_t* page = file->pages[offset / PGSIZE];
+    int page_ofs = offset % PGSIZE;
+    int chunk_size = size < PGSIZE - page_ofs ? size : PGSIZE - page_ofs;
+
+    if (page != NULL)
+      memcpy(buffer + bytes_read, page + page_ofs, chunk_size);
+    else
+      memset(buffer + bytes_read, 0, chunk_size);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    bytes_read += chunk_size;
+  }
+  lock_release(&tmpfs_lock);
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER at OFFSET of FILE_, extending it
+   if needed.  Stops short if memory runs out. */
+static off_t tmpfs_write_at(void* file_, const void* buffer_, off_t size, off_t offset) {
+  struct tmpfs_file* file = file_;
+  const uint8_t* buffer = buffer_;
+  off_t bytes_written = 0;
+
+  if (offset < 0 || offset >= TMPFS_MAX_LENGTH)
+    return 0;
+  if (size > TMPFS_MAX_LENGTH - offset)
+    size = TMPFS_MAX_LENGTH - offset;
+
+  lock_acquire(&tmpfs_lock);
+  while (size > 0) {
+    uint8_t** page = &file->pages[offset / PGSIZE];
+    int page_ofs = offset % PGSIZE;
+    int chunk_size = size < PGSIZE - page_ofs ? size : PGSIZE - page_ofs;
+
+    if (*page == NULL && (*page = palloc_get_page(PAL_ZERO)) == NULL)
+      break;
+    memcpy(*page + page_ofs, buffer + bytes_written, chunk_size);
+
+    size -= chunk_size;
+    offset += chunk_size;
+    bytes_written += chunk_size;
+  }
+  if (offset > file->length)
+    file->length = offset;
+  lock_release(&tmpfs_lock);
+
+  return bytes_written;
+}
+
+/* Returns the length of FILE_. */
+static off_t tmpfs_length(void* file_) {
+  struct tmpfs_file* file = file_;
+  lock_acquire(&tmpfs_lock);
+  off_t length = file->length;
+  lock_release(&tmpfs_lock);
+  return length;
+}
+
+/* Called when an inode opened on FILE_ is closed for the last
+   time.  Frees FILE_ if it was removed and this was its last
+   inode. */
+static void tmpfs_close(void* file_) {
+  struct tmpfs_file* file = file_;
+  lock_acquire(&tmpfs_lock);
+  if (--file->open_cnt == 0 && file->removed)
+    free_file(file);
+  lock_release(&tmpfs_lock);
+}
@@ -0,0 +1,6 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+void tmpfs_init(const char* path);
+
+#endif /* filesys/tmpfs.h */
@@ -0,0 +1,29 @@
+#ifndef __LIB_BLKSTAT_H
+#define __LIB_BLKSTAT_H
+
+/* Number of buckets in a latency histogram.  Bucket 0 counts
+   requests that took under 2 microseconds, bucket I > 0 those
+   that took at least 2**I but under 2**(I+1) microseconds, and
+   the last bucket also everything slower. */
+#define BLKSTAT_LATENCY_CNT 24
+
+/* Number of buckets in a queue depth distribution.  Bucket I
+   counts requests that found I others in progress when they were
+   submitted, and the last bucket also those that found more. */
+#define BLKSTAT_DEPTH_CNT 16
+
+/* Statistics on the requests submitted to a block device, as
+   returned by blk_stat(). */
+struct blkstat {
+  unsigned long long read_cnt;                 /* Read requests completed. */
+  unsigned long long write_cnt;                /* Write requests completed. */
+  unsigned long long read_bytes;               /* Bytes read. */
+  unsigned long long write_bytes;              /* Bytes written. */
+  unsigned read_latency[BLKSTAT_LATENCY_CNT];  /* Submission to completion of reads. */
+  unsigned write_latency[BLKSTAT_LATENCY_CNT]; /* Submission to completion of writes. */
+  unsigned depth[BLKSTAT_DEPTH_CNT];           /* Requests in progress at submission. */
+  unsigned long long poll_usec;                /* Microseconds spent polling the device. */
+  unsigned long long poll_sleeps;              /* Timer ticks slept while polling. */
+};
+
+#endif /* lib/blkstat.h */
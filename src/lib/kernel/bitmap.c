@@ -284,6 +284,21 @@ bool bitmap_write(const struct bitmap* b, struct file* file) {
   off_t size = byte_cnt(b->bit_cnt);
   return file_write_at(file, b->bits, size, 0) == size;
 }
+
+/* Writes the bytes of B that hold bits START through START + CNT
+   - 1 to the same offsets in FILE, which must hold the rest of B.
+   Return true if successful, false otherwise. */
+bool bitmap_write_range(const struct bitmap* b, struct file* file, size_t start, size_t cnt) {
+  ASSERT(b != NULL);
+  ASSERT(start <= b->bit_cnt);
+  ASSERT(start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+  off_t ofs = start / 8;
+  off_t size = (start + cnt - 1) / 8 + 1 - ofs;
+  return file_write_at(file, (const char*)b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -35,13 +35,28 @@ enum {
   SYS_MUNMAP, /* Remove a memory mapping. */
 
   /* Project 4 only. */
-  SYS_CHDIR,    /* Change the current directory. */
-  SYS_MKDIR,    /* Create a directory. */
-  SYS_READDIR,  /* Reads a directory entry. */
-  SYS_ISDIR,    /* Tests if a fd represents a directory. */
-  SYS_INUMBER,  /* Returns the inode number for a fd. */
-  SYS_BC_RESET, /* Reset the buffer cache. */
-  SYS_BC_STAT   /* Get stats on buffer cache hit rate and disk write count. */
+  SYS_CHDIR,           /* Change the current directory. */
+  SYS_MKDIR,           /* Create a directory. */
+  SYS_READDIR,         /* Reads a directory entry. */
+  SYS_ISDIR,           /* Tests if a fd represents a directory. */
+  SYS_INUMBER,         /* Returns the inode number for a fd. */
+  SYS_BC_RESET,        /* Reset the buffer cache. */
+  SYS_BC_STAT,         /* Get stats on buffer cache hit rate and disk write count. */
+  SYS_FSYNC,           /* Write a file's dirty data and metadata to disk. */
+  SYS_FDATASYNC,       /* Write a file's dirty data to disk. */
+  SYS_TICKS,           /* Get the number of timer ticks since boot. */
+  SYS_DEV_STAT,        /* Get file system device read and write counts. */
+  SYS_DEFRAG,          /* Move a file's blocks into contiguous runs. */
+  SYS_OPEN_DIRECT,     /* Open a file for I/O that bypasses the buffer cache. */
+  SYS_FADVISE,         /* Advise the buffer cache of a file's access pattern. */
+  SYS_READV,           /* Read from a file into several buffers. */
+  SYS_WRITEV,          /* Write to a file from several buffers. */
+  SYS_PREAD,           /* Read from a file at a given position. */
+  SYS_PWRITE,          /* Write to a file at a given position. */
+  SYS_COPY_FILE_RANGE, /* Copy bytes from one file to another in the kernel. */
+  SYS_FTRUNCATE,       /* Set a file's length. */
+  SYS_FALLOCATE,       /* Reserve disk space for part of a file. */
+  SYS_BLK_STAT         /* Get request statistics for a block device. */
 };
 
 #endif /* lib/syscall-nr.h */
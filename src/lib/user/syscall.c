@@ -64,6 +64,20 @@
     retval;                                                                                        \
   })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                                                   \
+  ({                                                                                               \
+    int retval;                                                                                    \
+    asm volatile("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "                    \
+                 "pushl %[number]; int $0x30; addl $20, %%esp"                                     \
+                 : "=a"(retval)                                                                    \
+                 : [number] "i"(NUMBER), [arg0] "r"(ARG0), [arg1] "r"(ARG1), [arg2] "r"(ARG2),     \
+                   [arg3] "r"(ARG3)                                                                \
+                 : "memory");                                                                      \
+    retval;                                                                                        \
+  })
+
 int practice(int i) { return syscall1(SYS_PRACTICE, i); }
 
 void halt(void) { syscall0(SYS_HALT); }
@@ -90,6 +104,32 @@ int write(int fd, const void* buffer, unsigned size) {
   return syscall3(SYS_WRITE, fd, buffer, size);
 }
 
+int readv(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall3(SYS_READV, fd, iov, iovcnt);
+}
+
+int writev(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall3(SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int pread(int fd, void* buffer, unsigned size, unsigned position) {
+  return syscall4(SYS_PREAD, fd, buffer, size, position);
+}
+
+int pwrite(int fd, const void* buffer, unsigned size, unsigned position) {
+  return syscall4(SYS_PWRITE, fd, buffer, size, position);
+}
+
+int copy_file_range(int fd_in, int fd_out, unsigned size) {
+  return syscall3(SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool ftruncate(int fd, unsigned size) { return syscall2(SYS_FTRUNCATE, fd, size); }
+
+bool fallocate(int fd, unsigned offset, unsigned size) {
+  return syscall3(SYS_FALLOCATE, fd, offset, size);
+}
+
 void seek(int fd, unsigned position) { syscall2(SYS_SEEK, fd, position); }
 
 unsigned tell(int fd) { return syscall1(SYS_TELL, fd); }
@@ -153,3 +193,19 @@ tid_t get_tid(void) { return syscall0(SYS_GET_TID); }
 void bc_reset(void) { syscall0(SYS_BC_RESET); }
 
 void bc_stat(float* f_ptr, int* w_ptr) { syscall2(SYS_BC_STAT, f_ptr, w_ptr); }
+
+bool fsync(int fd) { return syscall1(SYS_FSYNC, fd); }
+
+bool fdatasync(int fd) { return syscall1(SYS_FDATASYNC, fd); }
+
+int ticks(void) { return syscall0(SYS_TICKS); }
+
+void dev_stat(int* r_ptr, int* w_ptr) { syscall2(SYS_DEV_STAT, r_ptr, w_ptr); }
+
+bool blk_stat(const char* dev, struct blkstat* st) { return syscall2(SYS_BLK_STAT, dev, st); }
+
+int defrag(int fd) { return syscall1(SYS_DEFRAG, fd); }
+
+int open_direct(const char* file) { return syscall1(SYS_OPEN_DIRECT, file); }
+
+bool fadvise(int fd, int advice) { return syscall2(SYS_FADVISE, fd, advice); }
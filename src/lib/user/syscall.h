@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <blkstat.h>
 #include <debug.h>
+#include <iovec.h>
 #include <pthread.h>
 
 /* Process identifier. */
@@ -20,6 +22,14 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Access pattern hints for fadvise(). */
+#define FADV_NORMAL 0     /* No particular pattern. */
+#define FADV_SEQUENTIAL 1 /* Read sequentially: read ahead. */
+#define FADV_RANDOM 2     /* Read randomly: do not read ahead. */
+#define FADV_WILLNEED 3   /* Will be read soon: prefetch now. */
+#define FADV_DONTNEED 4   /* Will not be read soon: evict first. */
+#define FADV_NOREUSE 5    /* Will be read once: do not keep cached. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0 /* Successful execution. */
 #define EXIT_FAILURE 1 /* Unsuccessful execution. */
@@ -35,6 +45,13 @@ int open(const char* file);
 int filesize(int fd);
 int read(int fd, void* buffer, unsigned length);
 int write(int fd, const void* buffer, unsigned length);
+int readv(int fd, const struct iovec* iov, int iovcnt);
+int writev(int fd, const struct iovec* iov, int iovcnt);
+int pread(int fd, void* buffer, unsigned length, unsigned position);
+int pwrite(int fd, const void* buffer, unsigned length, unsigned position);
+int copy_file_range(int fd_in, int fd_out, unsigned length);
+bool ftruncate(int fd, unsigned length);
+bool fallocate(int fd, unsigned offset, unsigned length);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
@@ -63,5 +80,13 @@ bool isdir(int fd);
 int inumber(int fd);
 void bc_reset(void);
 void bc_stat(float* f_ptr, int* w_ptr);
+bool fsync(int fd);
+bool fdatasync(int fd);
+int ticks(void);
+void dev_stat(int* r_ptr, int* w_ptr);
+bool blk_stat(const char* dev, struct blkstat* st);
+int defrag(int fd);
+int open_direct(const char* file);
+bool fadvise(int fd, int advice);
 
 #endif /* lib/user/syscall.h */
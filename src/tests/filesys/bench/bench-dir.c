@@ -0,0 +1,47 @@
+/* Measures name lookup in a directory holding many files, both
+   for names that exist and for names that do not. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_CNT 200
+
+static int order[FILE_CNT];
+
+void test_main(void) {
+  char name[32];
+  struct bench b;
+  int i;
+
+  CHECK(mkdir("big"), "mkdir \"big\"");
+  bench_start(&b, "dir-fill");
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf(name, sizeof name, "big/file%d", i);
+    if (!create(name, 0))
+      fail("create \"%s\" failed", name);
+    order[i] = i;
+  }
+  bench_end(&b, FILE_CNT, 0);
+
+  shuffle(order, FILE_CNT, sizeof *order);
+  bench_start(&b, "dir-lookup-hit");
+  for (i = 0; i < FILE_CNT; i++) {
+    int fd;
+    snprintf(name, sizeof name, "big/file%d", order[i]);
+    if ((fd = open(name)) < 2)
+      fail("open \"%s\" failed", name);
+    close(fd);
+  }
+  bench_end(&b, FILE_CNT, 0);
+
+  bench_start(&b, "dir-lookup-miss");
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf(name, sizeof name, "big/none%d", i);
+    if (open(name) != -1)
+      fail("open \"%s\" should have failed", name);
+  }
+  bench_end(&b, FILE_CNT, 0);
+}
@@ -0,0 +1,59 @@
+/* Measures the rate of file creation, opening, and removal, and
+   of directory creation and removal. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_CNT 50
+#define DIR_CNT 20
+
+void test_main(void) {
+  char name[16];
+  struct bench b;
+  int i;
+
+  bench_start(&b, "create");
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf(name, sizeof name, "file%d", i);
+    if (!create(name, 0))
+      fail("create \"%s\" failed", name);
+  }
+  bench_end(&b, FILE_CNT, 0);
+
+  bench_start(&b, "open");
+  for (i = 0; i < FILE_CNT; i++) {
+    int fd;
+    snprintf(name, sizeof name, "file%d", i);
+    if ((fd = open(name)) < 2)
+      fail("open \"%s\" failed", name);
+    close(fd);
+  }
+  bench_end(&b, FILE_CNT, 0);
+
+  bench_start(&b, "unlink");
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf(name, sizeof name, "file%d", i);
+    if (!remove(name))
+      fail("remove \"%s\" failed", name);
+  }
+  bench_end(&b, FILE_CNT, 0);
+
+  bench_start(&b, "mkdir");
+  for (i = 0; i < DIR_CNT; i++) {
+    snprintf(name, sizeof name, "dir%d", i);
+    if (!mkdir(name))
+      fail("mkdir \"%s\" failed", name);
+  }
+  bench_end(&b, DIR_CNT, 0);
+
+  bench_start(&b, "rmdir");
+  for (i = 0; i < DIR_CNT; i++) {
+    snprintf(name, sizeof name, "dir%d", i);
+    if (!remove(name))
+      fail("remove \"%s\" failed", name);
+  }
+  bench_end(&b, DIR_CNT, 0);
+}
@@ -0,0 +1,67 @@
+/* Measures random-offset read and write throughput of a 64 kB
+   file at several I/O sizes. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_SIZE 65536
+#define MAX_BLOCKS (FILE_SIZE / 512)
+
+static char buf[FILE_SIZE];
+static char chunk[4096];
+static size_t order[MAX_BLOCKS];
+
+static const size_t io_sizes[] = {512, 4096};
+
+/* Rewrites, then reads back, FD's blocks of IO_SIZE bytes in a
+   random order. */
+static void random_io(int fd, size_t io_size) {
+  size_t block_cnt = FILE_SIZE / io_size;
+  char name[32];
+  struct bench b;
+  size_t i;
+
+  for (i = 0; i < block_cnt; i++)
+    order[i] = i;
+
+  shuffle(order, block_cnt, sizeof *order);
+  snprintf(name, sizeof name, "random-write-%zu", io_size);
+  bench_start(&b, name);
+  for (i = 0; i < block_cnt; i++) {
+    size_t ofs = order[i] * io_size;
+    seek(fd, ofs);
+    if (write(fd, buf + ofs, io_size) != (int)io_size)
+      fail("write %zu bytes at offset %zu in \"data\" failed", io_size, ofs);
+  }
+  bench_end(&b, block_cnt, FILE_SIZE);
+
+  shuffle(order, block_cnt, sizeof *order);
+  snprintf(name, sizeof name, "random-read-%zu", io_size);
+  bench_start(&b, name);
+  for (i = 0; i < block_cnt; i++) {
+    size_t ofs = order[i] * io_size;
+    seek(fd, ofs);
+    if (read(fd, chunk, io_size) != (int)io_size)
+      fail("read %zu bytes at offset %zu in \"data\" failed", io_size, ofs);
+    compare_bytes(chunk, buf + ofs, io_size, ofs, "data");
+  }
+  bench_end(&b, block_cnt, FILE_SIZE);
+}
+
+void test_main(void) {
+  size_t i;
+  int fd;
+
+  random_init(0);
+  random_bytes(buf, sizeof buf);
+  CHECK(create("data", FILE_SIZE), "create \"data\"");
+  CHECK((fd = open("data")) > 1, "open \"data\"");
+  for (i = 0; i < sizeof io_sizes / sizeof *io_sizes; i++)
+    random_io(fd, io_sizes[i]);
+  msg("close \"data\"");
+  close(fd);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+my ($bench_cnt) = scalar (grep (/^\(bench-random\) BENCH name=\S+ ops=\d+ bytes=\d+ ticks=\d+ hit_permille=\d+ reads=\d+ writes=\d+$/, @output));
+fail "expected 4 BENCH lines, found $bench_cnt\n" if $bench_cnt != 4;
+fail "bench-random did not finish\n" if !grep (/^\(bench-random\) end$/, @output);
+pass;
@@ -0,0 +1,30 @@
+/* Measures read throughput with many processes reading the same
+   file at once. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/bench-shared.h"
+
+static char buf[SHARED_SIZE];
+
+void test_main(void) {
+  pid_t children[CHILD_CNT];
+  struct bench b;
+  int fd;
+
+  CHECK(create(file_name, 0), "create \"%s\"", file_name);
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+  random_init(0);
+  random_bytes(buf, sizeof buf);
+  CHECK(write(fd, buf, sizeof buf) == sizeof buf, "write \"%s\"", file_name);
+  msg("close \"%s\"", file_name);
+  close(fd);
+
+  bench_start(&b, "readers");
+  exec_children("child-bench-rd", children, CHILD_CNT);
+  wait_children(children, CHILD_CNT);
+  bench_end(&b, CHILD_CNT * (SHARED_SIZE / CHUNK_SIZE), CHILD_CNT * SHARED_SIZE);
+}
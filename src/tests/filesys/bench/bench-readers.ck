@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+my ($bench_cnt) = scalar (grep (/^\(bench-readers\) BENCH name=\S+ ops=\d+ bytes=\d+ ticks=\d+ hit_permille=\d+ reads=\d+ writes=\d+$/, @output));
+fail "expected 1 BENCH lines, found $bench_cnt\n" if $bench_cnt != 1;
+fail "bench-readers did not finish\n" if !grep (/^\(bench-readers\) end$/, @output);
+pass;
@@ -0,0 +1,57 @@
+/* Measures sequential write and read throughput of a 64 kB
+   file at several I/O sizes. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_SIZE 65536
+
+static char buf[FILE_SIZE];
+static char chunk[16384];
+
+static const size_t io_sizes[] = {512, 4096, 16384};
+
+/* Writes, then reads back, a file in IO_SIZE-byte chunks. */
+static void seq_io(size_t io_size) {
+  char file_name[16], name[32];
+  struct bench b;
+  size_t ofs;
+  int fd;
+
+  snprintf(file_name, sizeof file_name, "seq-%zu", io_size);
+  CHECK(create(file_name, 0), "create \"%s\"", file_name);
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+
+  snprintf(name, sizeof name, "seq-write-%zu", io_size);
+  bench_start(&b, name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += io_size)
+    if (write(fd, buf + ofs, io_size) != (int)io_size)
+      fail("write %zu bytes at offset %zu in \"%s\" failed", io_size, ofs, file_name);
+  bench_end(&b, FILE_SIZE / io_size, FILE_SIZE);
+
+  seek(fd, 0);
+  snprintf(name, sizeof name, "seq-read-%zu", io_size);
+  bench_start(&b, name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += io_size) {
+    if (read(fd, chunk, io_size) != (int)io_size)
+      fail("read %zu bytes at offset %zu in \"%s\" failed", io_size, ofs, file_name);
+    compare_bytes(chunk, buf + ofs, io_size, ofs, file_name);
+  }
+  bench_end(&b, FILE_SIZE / io_size, FILE_SIZE);
+
+  msg("close \"%s\"", file_name);
+  close(fd);
+  CHECK(remove(file_name), "remove \"%s\"", file_name);
+}
+
+void test_main(void) {
+  size_t i;
+
+  random_bytes(buf, sizeof buf);
+  for (i = 0; i < sizeof io_sizes / sizeof *io_sizes; i++)
+    seq_io(io_sizes[i]);
+}
@@ -0,0 +1,12 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_SHARED_H
+#define TESTS_FILESYS_BENCH_BENCH_SHARED_H
+
+/* Shared file used by the bench-readers and bench-writers
+   contention benchmarks and their children. */
+#define CHILD_CNT 8
+#define CHUNK_SIZE 512
+#define CHILD_SIZE 4096
+#define SHARED_SIZE (CHILD_CNT * CHILD_SIZE)
+static const char file_name[] = "shared";
+
+#endif /* tests/filesys/bench/bench-shared.h */
@@ -0,0 +1,20 @@
+/* Measures write throughput with many processes writing disjoint
+   regions of the same file at once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/bench-shared.h"
+
+void test_main(void) {
+  pid_t children[CHILD_CNT];
+  struct bench b;
+
+  CHECK(create(file_name, SHARED_SIZE), "create \"%s\"", file_name);
+
+  bench_start(&b, "writers");
+  exec_children("child-bench-wr", children, CHILD_CNT);
+  wait_children(children, CHILD_CNT);
+  bench_end(&b, CHILD_CNT * (CHILD_SIZE / CHUNK_SIZE), SHARED_SIZE);
+}
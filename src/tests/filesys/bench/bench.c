@@ -0,0 +1,41 @@
+/* Helpers shared by the file system benchmarks.
+
+   Each benchmark phase runs between bench_start() and
+   bench_end(), which prints one line of the form
+
+     BENCH name=NAME ops=N bytes=N ticks=N hit_permille=N reads=N writes=N
+
+   where ticks is elapsed timer ticks, hit_permille is the buffer
+   cache hit rate in thousandths over the phase, and reads and
+   writes count file system device sector transfers.  The .ck
+   scripts only check that these lines are present; the numbers
+   are for comparing runs. */
+
+#include "tests/filesys/bench/bench.h"
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Starts phase NAME in B, with a cold buffer cache. */
+void bench_start(struct bench* b, const char* name) {
+  b->name = name;
+  bc_reset();
+  dev_stat(&b->start_reads, &b->start_writes);
+  b->start_ticks = ticks();
+}
+
+/* Ends the phase in B, which performed OP_CNT operations moving
+   BYTE_CNT bytes, and reports its results. */
+void bench_end(struct bench* b, int op_cnt, size_t byte_cnt) {
+  int end_ticks = ticks();
+  float hit_rate;
+  int reads, writes;
+
+  bc_stat(&hit_rate, NULL);
+  dev_stat(&reads, &writes);
+  /* A phase that never touched the cache has a NaN hit rate. */
+  int hit_permille = hit_rate == hit_rate ? (int)(hit_rate * 1000) : 0;
+
+  msg("BENCH name=%s ops=%d bytes=%zu ticks=%d hit_permille=%d reads=%d writes=%d", b->name,
+      op_cnt, byte_cnt, end_ticks - b->start_ticks, hit_permille, reads - b->start_reads,
+      writes - b->start_writes);
+}
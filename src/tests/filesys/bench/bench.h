@@ -0,0 +1,17 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_H
+#define TESTS_FILESYS_BENCH_BENCH_H
+
+#include <stddef.h>
+
+/* One timed benchmark phase. */
+struct bench {
+  const char* name; /* Phase name, reported as-is. */
+  int start_ticks;  /* Timer ticks at bench_start(). */
+  int start_reads;  /* Device reads at bench_start(). */
+  int start_writes; /* Device writes at bench_start(). */
+};
+
+void bench_start(struct bench*, const char* name);
+void bench_end(struct bench*, int op_cnt, size_t byte_cnt);
+
+#endif /* tests/filesys/bench/bench.h */
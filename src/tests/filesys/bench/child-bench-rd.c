@@ -0,0 +1,34 @@
+/* Child process for bench-readers.
+   Reads the whole shared file in CHUNK_SIZE pieces and checks
+   its contents. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/bench/bench-shared.h"
+
+static char buf[SHARED_SIZE];
+static char chunk[CHUNK_SIZE];
+
+int main(int argc, const char* argv[]) {
+  size_t ofs;
+  int fd;
+
+  test_name = "child-bench-rd";
+  quiet = true;
+
+  CHECK(argc == 2, "argc must be 2, actually %d", argc);
+
+  random_init(0);
+  random_bytes(buf, sizeof buf);
+
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < SHARED_SIZE; ofs += CHUNK_SIZE) {
+    CHECK(read(fd, chunk, CHUNK_SIZE) == CHUNK_SIZE, "read \"%s\"", file_name);
+    compare_bytes(chunk, buf + ofs, CHUNK_SIZE, ofs, file_name);
+  }
+  close(fd);
+
+  return atoi(argv[1]);
+}
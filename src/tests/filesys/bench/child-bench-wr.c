@@ -0,0 +1,32 @@
+/* Child process for bench-writers.
+   Writes its own CHILD_SIZE-byte region of the shared file in
+   CHUNK_SIZE pieces. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/bench/bench-shared.h"
+
+static char chunk[CHUNK_SIZE];
+
+int main(int argc, const char* argv[]) {
+  int child_idx;
+  size_t ofs;
+  int fd;
+
+  test_name = "child-bench-wr";
+  quiet = true;
+
+  CHECK(argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi(argv[1]);
+  memset(chunk, 'A' + child_idx, sizeof chunk);
+
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+  seek(fd, child_idx * CHILD_SIZE);
+  for (ofs = 0; ofs < CHILD_SIZE; ofs += CHUNK_SIZE)
+    CHECK(write(fd, chunk, CHUNK_SIZE) == CHUNK_SIZE, "write \"%s\"", file_name);
+  close(fd);
+
+  return child_idx;
+}
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($a) = random_bytes (9000);
+check_archive ({"a" => [$a], "b" => [substr ($a, 100)]});
+pass;
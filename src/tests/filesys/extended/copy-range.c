@@ -0,0 +1,43 @@
+/* Copies most of one file into another with copy_file_range(),
+   in two calls, checking that both file positions advance and
+   that the copy stops at end of file. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 9000
+#define SKIP 100
+static char buf_a[FILE_SIZE];
+
+void test_main(void) {
+  int a_fd, b_fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK((a_fd = open("a")) > 1, "open \"a\"");
+  CHECK(write(a_fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+  CHECK(create("b", 0), "create \"b\"");
+  CHECK((b_fd = open("b")) > 1, "open \"b\"");
+
+  seek(a_fd, SKIP);
+  CHECK(copy_file_range(a_fd, b_fd, 8000) == 8000, "copy 8000 bytes from \"a\" to \"b\"");
+  CHECK(tell(a_fd) == SKIP + 8000, "tell \"a\" after copy");
+  CHECK(tell(b_fd) == 8000, "tell \"b\" after copy");
+  CHECK(copy_file_range(a_fd, b_fd, 8000) == FILE_SIZE - SKIP - 8000,
+        "copy rest of \"a\" to \"b\"");
+  CHECK(copy_file_range(a_fd, b_fd, 8000) == 0, "copy at end of \"a\"");
+  CHECK(filesize(b_fd) == FILE_SIZE - SKIP, "filesize \"b\"");
+
+  seek(b_fd, 0);
+  check_file_handle(b_fd, "b", buf_a + SKIP, FILE_SIZE - SKIP);
+
+  CHECK(copy_file_range(a_fd, 42, 10) == -1, "copy to a bad fd fails");
+  msg("close \"a\"");
+  close(a_fd);
+  msg("close \"b\"");
+  close(b_fd);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "a"
+(copy-range) open "a"
+(copy-range) write "a"
+(copy-range) create "b"
+(copy-range) open "b"
+(copy-range) copy 8000 bytes from "a" to "b"
+(copy-range) tell "a" after copy
+(copy-range) tell "b" after copy
+(copy-range) copy rest of "a" to "b"
+(copy-range) copy at end of "a"
+(copy-range) filesize "b"
+(copy-range) verified contents of "b"
+(copy-range) copy to a bad fd fails
+(copy-range) close "a"
+(copy-range) close "b"
+(copy-range) end
+EOF
+pass;
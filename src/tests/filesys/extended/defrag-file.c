@@ -0,0 +1,54 @@
+/* Grows two files in alternating 512-byte writes, so that their
+   blocks interleave, then defragments one of them while it is
+   open.  Its blocks must move, a second pass must find nothing
+   left to move, and both files must keep their contents. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 512
+#define FILE_SIZE (20 * CHUNK_SIZE)
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+void test_main(void) {
+  int fd_a, fd_b, dir_fd;
+  size_t ofs;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+  random_bytes(buf_b, sizeof buf_b);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK(create("b", 0), "create \"b\"");
+  CHECK((fd_a = open("a")) > 1, "open \"a\"");
+  CHECK((fd_b = open("b")) > 1, "open \"b\"");
+
+  msg("write \"a\" and \"b\" alternately");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE) {
+    if (write(fd_a, buf_a + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+      fail("write \"a\" at offset %zu failed", ofs);
+    if (write(fd_b, buf_b + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+      fail("write \"b\" at offset %zu failed", ofs);
+  }
+
+  CHECK(defrag(fd_a) > 0, "defrag \"a\"");
+  CHECK(defrag(fd_a) == 0, "defrag \"a\" again moves nothing");
+  seek(fd_a, 0);
+  check_file_handle(fd_a, "a", buf_a, FILE_SIZE);
+  seek(fd_b, 0);
+  check_file_handle(fd_b, "b", buf_b, FILE_SIZE);
+
+  CHECK((dir_fd = open(".")) > 1, "open \".\"");
+  CHECK(defrag(dir_fd) == -1, "defrag of a directory fails");
+  CHECK(defrag(fd_b + 10) == -1, "defrag of a closed fd fails");
+
+  msg("close \".\"");
+  close(dir_fd);
+  msg("close \"a\"");
+  close(fd_a);
+  msg("close \"b\"");
+  close(fd_b);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(defrag-file) begin
+(defrag-file) create "a"
+(defrag-file) create "b"
+(defrag-file) open "a"
+(defrag-file) open "b"
+(defrag-file) write "a" and "b" alternately
+(defrag-file) defrag "a"
+(defrag-file) defrag "a" again moves nothing
+(defrag-file) verified contents of "a"
+(defrag-file) verified contents of "b"
+(defrag-file) open "."
+(defrag-file) defrag of a directory fails
+(defrag-file) defrag of a closed fd fails
+(defrag-file) close "."
+(defrag-file) close "a"
+(defrag-file) close "b"
+(defrag-file) end
+EOF
+pass;
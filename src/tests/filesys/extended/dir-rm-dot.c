@@ -0,0 +1,22 @@
+/* Tries to remove "." and ".." in a subdirectory and in the root,
+   which must fail without disturbing either directory, then
+   removes the subdirectory. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  CHECK(mkdir("a"), "mkdir \"a\"");
+  CHECK(chdir("a"), "chdir \"a\"");
+  CHECK(!remove("."), "remove \".\" (must fail)");
+  CHECK(!remove(".."), "remove \"..\" (must fail)");
+  CHECK(!remove("/a/."), "remove \"/a/.\" (must fail)");
+  CHECK(!remove("/."), "remove \"/.\" (must fail)");
+  CHECK(!remove("/.."), "remove \"/..\" (must fail)");
+  CHECK(create("x", 0), "create \"x\"");
+  CHECK(remove("x"), "remove \"x\"");
+  CHECK(chdir("/"), "chdir \"/\"");
+  CHECK(remove("a"), "rmdir \"a\"");
+  CHECK(!chdir("a"), "chdir \"a\" (must return false)");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-rm-dot) begin
+(dir-rm-dot) mkdir "a"
+(dir-rm-dot) chdir "a"
+(dir-rm-dot) remove "." (must fail)
+(dir-rm-dot) remove ".." (must fail)
+(dir-rm-dot) remove "/a/." (must fail)
+(dir-rm-dot) remove "/." (must fail)
+(dir-rm-dot) remove "/.." (must fail)
+(dir-rm-dot) create "x"
+(dir-rm-dot) remove "x"
+(dir-rm-dot) chdir "/"
+(dir-rm-dot) rmdir "a"
+(dir-rm-dot) chdir "a" (must return false)
+(dir-rm-dot) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Writes and reads a file opened with open_direct(), checking
+   that whole sectors go to the device every time instead of
+   being cached, and that a second, ordinary descriptor for the
+   same file sees the direct writes and vice versa. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+#define FILE_SIZE (16 * SECTOR_SIZE)
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+void test_main(void) {
+  int direct_fd, cached_fd, start_cnt, end_cnt;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+  random_bytes(buf_b, sizeof buf_b);
+
+  CHECK(create("a", FILE_SIZE), "create \"a\"");
+  CHECK((direct_fd = open_direct("a")) > 1, "open_direct \"a\"");
+  CHECK((cached_fd = open("a")) > 1, "open \"a\"");
+
+  /* Every sector of a direct write reaches the device at once. */
+  bc_stat(NULL, &start_cnt);
+  CHECK(write(direct_fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\" directly");
+  bc_stat(NULL, &end_cnt);
+  CHECK(end_cnt - start_cnt >= FILE_SIZE / SECTOR_SIZE, "direct write reached the device");
+  check_file_handle(cached_fd, "a", buf_a, FILE_SIZE);
+
+  /* Direct reads are served by the device each time. */
+  bc_reset();
+  seek(direct_fd, 0);
+  dev_stat(&start_cnt, NULL);
+  CHECK(read(direct_fd, buf, FILE_SIZE) == FILE_SIZE, "read \"a\" directly");
+  seek(direct_fd, 0);
+  CHECK(read(direct_fd, buf, FILE_SIZE) == FILE_SIZE, "read \"a\" directly again");
+  dev_stat(&end_cnt, NULL);
+  CHECK(end_cnt - start_cnt >= 2 * FILE_SIZE / SECTOR_SIZE, "direct reads bypassed the cache");
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  /* A dirty cached sector is visible to a direct read. */
+  seek(cached_fd, 0);
+  CHECK(write(cached_fd, buf_b, SECTOR_SIZE) == SECTOR_SIZE, "write sector 0 of \"a\" cached");
+  seek(direct_fd, 0);
+  CHECK(read(direct_fd, buf, SECTOR_SIZE) == SECTOR_SIZE, "read sector 0 of \"a\" directly");
+  compare_bytes(buf, buf_b, SECTOR_SIZE, 0, "a");
+
+  /* A direct write replaces a cached copy of the sector. */
+  seek(cached_fd, SECTOR_SIZE);
+  CHECK(read(cached_fd, buf, SECTOR_SIZE) == SECTOR_SIZE, "read sector 1 of \"a\" cached");
+  seek(direct_fd, SECTOR_SIZE);
+  CHECK(write(direct_fd, buf_b + SECTOR_SIZE, SECTOR_SIZE) == SECTOR_SIZE,
+        "write sector 1 of \"a\" directly");
+  seek(cached_fd, SECTOR_SIZE);
+  CHECK(read(cached_fd, buf, SECTOR_SIZE) == SECTOR_SIZE, "read sector 1 of \"a\" cached again");
+  compare_bytes(buf, buf_b + SECTOR_SIZE, SECTOR_SIZE, SECTOR_SIZE, "a");
+
+  CHECK(open_direct("/") == -1, "open_direct of a directory fails");
+
+  msg("close \"a\"");
+  close(direct_fd);
+  close(cached_fd);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(direct-io) begin
+(direct-io) create "a"
+(direct-io) open_direct "a"
+(direct-io) open "a"
+(direct-io) write "a" directly
+(direct-io) direct write reached the device
+(direct-io) verified contents of "a"
+(direct-io) read "a" directly
+(direct-io) read "a" directly again
+(direct-io) direct reads bypassed the cache
+(direct-io) write sector 0 of "a" cached
+(direct-io) read sector 0 of "a" directly
+(direct-io) read sector 1 of "a" cached
+(direct-io) write sector 1 of "a" directly
+(direct-io) read sector 1 of "a" cached again
+(direct-io) open_direct of a directory fails
+(direct-io) close "a"
+(direct-io) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($hot) = "\0" x 2048;
+my ($medium) = "\0" x 4096;
+my ($big) = "\0" x 51200;
+check_archive ({"hot" => [$hot], "medium" => [$medium], "big" => [$big]});
+pass;
@@ -0,0 +1,89 @@
+/* Checks that fadvise() hints steer cache replacement.  While
+   memory is free, the page cache grows to hold a scan of a file
+   larger than its initial size instead of evicting a small, hot
+   file, and a scan advised FADV_NOREUSE does not touch it at all.
+   A hot file advised FADV_DONTNEED is dropped at once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+#define HOT_SIZE (4 * SECTOR_SIZE)
+#define MEDIUM_SIZE (8 * SECTOR_SIZE)
+#define BIG_SIZE (100 * SECTOR_SIZE)
+
+static char buf[SECTOR_SIZE];
+
+/* Reads all SIZE bytes of FD from the start. */
+static void read_all(int fd, size_t size) {
+  size_t ofs;
+  seek(fd, 0);
+  for (ofs = 0; ofs < size; ofs += SECTOR_SIZE)
+    if (read(fd, buf, SECTOR_SIZE) != SECTOR_SIZE)
+      fail("read at offset %zu failed", ofs);
+}
+
+/* Returns the number of device reads needed to read FD's SIZE
+   bytes again. */
+static int reread_cost(int fd, size_t size) {
+  int start_cnt, end_cnt;
+  dev_stat(&start_cnt, NULL);
+  read_all(fd, size);
+  dev_stat(&end_cnt, NULL);
+  return end_cnt - start_cnt;
+}
+
+void test_main(void) {
+  int hot_fd, medium_fd, big_fd;
+
+  CHECK(create("hot", HOT_SIZE), "create \"hot\"");
+  CHECK(create("medium", MEDIUM_SIZE), "create \"medium\"");
+  CHECK(create("big", BIG_SIZE), "create \"big\"");
+  CHECK((hot_fd = open("hot")) > 1, "open \"hot\"");
+  CHECK((medium_fd = open("medium")) > 1, "open \"medium\"");
+  CHECK((big_fd = open("big")) > 1, "open \"big\"");
+
+  /* An unadvised scan grows the cache rather than evict. */
+  bc_reset();
+  read_all(hot_fd, HOT_SIZE);
+  read_all(big_fd, BIG_SIZE);
+  CHECK(reread_cost(hot_fd, HOT_SIZE) == 0, "scan without a hint keeps \"hot\" cached");
+
+  /* A scan advised FADV_NOREUSE leaves it cached. */
+  bc_reset();
+  read_all(hot_fd, HOT_SIZE);
+  CHECK(fadvise(big_fd, FADV_NOREUSE), "fadvise \"big\" FADV_NOREUSE");
+  read_all(big_fd, BIG_SIZE);
+  CHECK(reread_cost(hot_fd, HOT_SIZE) == 0, "FADV_NOREUSE scan keeps \"hot\" cached");
+
+  /* Without a hint, the hot file outlives a small read... */
+  bc_reset();
+  read_all(hot_fd, HOT_SIZE);
+  read_all(medium_fd, MEDIUM_SIZE);
+  CHECK(reread_cost(hot_fd, HOT_SIZE) == 0, "\"hot\" survives reading \"medium\"");
+
+  /* ...but not once advised FADV_DONTNEED. */
+  bc_reset();
+  read_all(hot_fd, HOT_SIZE);
+  CHECK(fadvise(hot_fd, FADV_DONTNEED), "fadvise \"hot\" FADV_DONTNEED");
+  read_all(medium_fd, MEDIUM_SIZE);
+  CHECK(reread_cost(hot_fd, HOT_SIZE) >= HOT_SIZE / SECTOR_SIZE,
+        "FADV_DONTNEED evicts \"hot\" first");
+
+  /* Read-ahead hints are accepted and reads stay correct. */
+  CHECK(fadvise(big_fd, FADV_SEQUENTIAL), "fadvise \"big\" FADV_SEQUENTIAL");
+  read_all(big_fd, BIG_SIZE);
+  seek(big_fd, 0);
+  CHECK(fadvise(big_fd, FADV_WILLNEED), "fadvise \"big\" FADV_WILLNEED");
+  CHECK(fadvise(big_fd, FADV_RANDOM), "fadvise \"big\" FADV_RANDOM");
+  read_all(big_fd, BIG_SIZE);
+
+  CHECK(!fadvise(big_fd, 42), "unknown hint is rejected");
+  CHECK(!fadvise(big_fd + 10, FADV_NORMAL), "fadvise of a closed fd fails");
+
+  msg("close files");
+  close(hot_fd);
+  close(medium_fd);
+  close(big_fd);
+}
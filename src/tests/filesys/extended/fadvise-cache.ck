@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fadvise-cache) begin
+(fadvise-cache) create "hot"
+(fadvise-cache) create "medium"
+(fadvise-cache) create "big"
+(fadvise-cache) open "hot"
+(fadvise-cache) open "medium"
+(fadvise-cache) open "big"
+(fadvise-cache) scan without a hint keeps "hot" cached
+(fadvise-cache) fadvise "big" FADV_NOREUSE
+(fadvise-cache) FADV_NOREUSE scan keeps "hot" cached
+(fadvise-cache) "hot" survives reading "medium"
+(fadvise-cache) fadvise "hot" FADV_DONTNEED
+(fadvise-cache) FADV_DONTNEED evicts "hot" first
+(fadvise-cache) fadvise "big" FADV_SEQUENTIAL
+(fadvise-cache) fadvise "big" FADV_WILLNEED
+(fadvise-cache) fadvise "big" FADV_RANDOM
+(fadvise-cache) unknown hint is rejected
+(fadvise-cache) fadvise of a closed fd fails
+(fadvise-cache) close files
+(fadvise-cache) end
+EOF
+pass;
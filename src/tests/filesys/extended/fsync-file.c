@@ -0,0 +1,52 @@
+/* Test that fsync() and fdatasync() write back only the dirty blocks
+   of the file they are given. Two 8KiB files (16 blocks each) are
+   written; fsync() of one must not write the other's data. Rewriting
+   the first file in place and calling fdatasync() must write exactly
+   its 16 data blocks, since its length and inode are unchanged. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 8192
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+void test_main(void) {
+  int fd_a, fd_b;
+  int start_cnt, end_cnt;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+  random_bytes(buf_b, sizeof buf_b);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK(create("b", 0), "create \"b\"");
+  CHECK((fd_a = open("a")) > 1, "open \"a\"");
+  CHECK((fd_b = open("b")) > 1, "open \"b\"");
+  CHECK(write(fd_a, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+  CHECK(write(fd_b, buf_b, FILE_SIZE) == FILE_SIZE, "write \"b\"");
+
+  /* Both files' data blocks are dirty; only "a"'s may be written. */
+  bc_stat(NULL, &start_cnt);
+  CHECK(fsync(fd_a), "fsync \"a\"");
+  bc_stat(NULL, &end_cnt);
+  CHECK(end_cnt - start_cnt >= FILE_SIZE / 512, "fsync wrote \"a\"'s data blocks");
+  CHECK(end_cnt - start_cnt < 2 * FILE_SIZE / 512, "fsync did not write \"b\"'s data blocks");
+
+  /* Rewrite "a" in place; its inode does not change. */
+  seek(fd_a, 0);
+  CHECK(write(fd_a, buf_a, FILE_SIZE) == FILE_SIZE, "rewrite \"a\"");
+  bc_stat(NULL, &start_cnt);
+  CHECK(fdatasync(fd_a), "fdatasync \"a\"");
+  bc_stat(NULL, &end_cnt);
+  CHECK(end_cnt - start_cnt == FILE_SIZE / 512, "fdatasync wrote only \"a\"'s data blocks");
+
+  CHECK(!fsync(fd_b + 10), "fsync of a closed fd fails");
+
+  msg("close \"a\"");
+  close(fd_a);
+  msg("close \"b\"");
+  close(fd_b);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync-file) begin
+(fsync-file) create "a"
+(fsync-file) create "b"
+(fsync-file) open "a"
+(fsync-file) open "b"
+(fsync-file) write "a"
+(fsync-file) write "b"
+(fsync-file) fsync "a"
+(fsync-file) fsync wrote "a"'s data blocks
+(fsync-file) fsync did not write "b"'s data blocks
+(fsync-file) rewrite "a"
+(fsync-file) fdatasync "a"
+(fsync-file) fdatasync wrote only "a"'s data blocks
+(fsync-file) fsync of a closed fd fails
+(fsync-file) close "a"
+(fsync-file) close "b"
+(fsync-file) end
+EOF
+pass;
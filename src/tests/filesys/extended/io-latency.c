@@ -0,0 +1,49 @@
+/* Does single-sector direct reads and writes and checks with
+   blk_stat() that the disk driver carries nearly all of them out
+   without sleeping a timer tick on the disk's status, that is,
+   that it waits for interrupts rather than sleep-polling. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+#define SECTOR_CNT 64
+#define FILE_SIZE (SECTOR_CNT * SECTOR_SIZE)
+
+static char buf_a[FILE_SIZE];
+static char buf[SECTOR_SIZE];
+
+void test_main(void) {
+  struct blkstat before, after;
+  unsigned long long requests, sleeps;
+  size_t i;
+  int fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", FILE_SIZE), "create \"a\"");
+  CHECK((fd = open_direct("a")) > 1, "open_direct \"a\"");
+
+  CHECK(blk_stat(NULL, &before), "blk_stat before");
+  for (i = 0; i < SECTOR_CNT; i++)
+    if (write(fd, buf_a + i * SECTOR_SIZE, SECTOR_SIZE) != SECTOR_SIZE)
+      fail("write of sector %zu failed", i);
+  seek(fd, 0);
+  for (i = 0; i < SECTOR_CNT; i++) {
+    if (read(fd, buf, SECTOR_SIZE) != SECTOR_SIZE)
+      fail("read of sector %zu failed", i);
+    compare_bytes(buf, buf_a + i * SECTOR_SIZE, SECTOR_SIZE, i * SECTOR_SIZE, "a");
+  }
+  CHECK(blk_stat(NULL, &after), "blk_stat after");
+
+  requests = (after.read_cnt - before.read_cnt) + (after.write_cnt - before.write_cnt);
+  sleeps = after.poll_sleeps - before.poll_sleeps;
+  CHECK(requests >= 2 * SECTOR_CNT, "all reads and writes reach the disk");
+  CHECK(sleeps * 10 <= requests, "at most 10%% of requests sleep on the disk's status");
+
+  msg("close \"a\"");
+  close(fd);
+}
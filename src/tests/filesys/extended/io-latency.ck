@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(io-latency) begin
+(io-latency) create "a"
+(io-latency) open_direct "a"
+(io-latency) blk_stat before
+(io-latency) blk_stat after
+(io-latency) all reads and writes reach the disk
+(io-latency) at most 10% of requests sleep on the disk's status
+(io-latency) close "a"
+(io-latency) end
+EOF
+pass;
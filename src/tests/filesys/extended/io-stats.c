@@ -0,0 +1,59 @@
+/* Checks that blk_stat() reports the requests a file's direct
+   reads and writes send to the file system device: counts and
+   bytes grow by at least the amount transferred, and every
+   completed request lands in one latency bucket and every
+   submitted one in one queue depth bucket. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+#define FILE_SIZE (8 * SECTOR_SIZE)
+static char buf_a[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+/* Returns the sum of the CNT buckets in HIST. */
+static unsigned long long sum(const unsigned* hist, size_t cnt) {
+  unsigned long long total = 0;
+  size_t i;
+  for (i = 0; i < cnt; i++)
+    total += hist[i];
+  return total;
+}
+
+void test_main(void) {
+  struct blkstat before, after;
+  int fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", FILE_SIZE), "create \"a\"");
+  CHECK((fd = open_direct("a")) > 1, "open_direct \"a\"");
+
+  CHECK(blk_stat(NULL, &before), "blk_stat of the file system device");
+  CHECK(write(fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\" directly");
+  seek(fd, 0);
+  CHECK(read(fd, buf, FILE_SIZE) == FILE_SIZE, "read \"a\" directly");
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+  CHECK(blk_stat(NULL, &after), "blk_stat again");
+
+  CHECK(after.write_cnt > before.write_cnt, "write requests counted");
+  CHECK(after.write_bytes - before.write_bytes >= FILE_SIZE, "bytes written counted");
+  CHECK(after.read_cnt > before.read_cnt, "read requests counted");
+  CHECK(after.read_bytes - before.read_bytes >= FILE_SIZE, "bytes read counted");
+
+  CHECK(sum(after.read_latency, BLKSTAT_LATENCY_CNT) == after.read_cnt,
+        "one read latency per read");
+  CHECK(sum(after.write_latency, BLKSTAT_LATENCY_CNT) == after.write_cnt,
+        "one write latency per write");
+  CHECK(sum(after.depth, BLKSTAT_DEPTH_CNT) >= after.read_cnt + after.write_cnt,
+        "one queue depth per request");
+
+  CHECK(!blk_stat("no-such-device", &after), "blk_stat of an unknown device fails");
+
+  msg("close \"a\"");
+  close(fd);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(io-stats) begin
+(io-stats) create "a"
+(io-stats) open_direct "a"
+(io-stats) blk_stat of the file system device
+(io-stats) write "a" directly
+(io-stats) read "a" directly
+(io-stats) blk_stat again
+(io-stats) write requests counted
+(io-stats) bytes written counted
+(io-stats) read requests counted
+(io-stats) bytes read counted
+(io-stats) one read latency per read
+(io-stats) one write latency per write
+(io-stats) one queue depth per request
+(io-stats) blk_stat of an unknown device fails
+(io-stats) close "a"
+(io-stats) end
+EOF
+pass;
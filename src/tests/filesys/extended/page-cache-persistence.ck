@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($a) = random_bytes (8192);
+my ($b) = random_bytes (8192);
+my ($data) = substr ($b, 512, 512) . substr ($a, 512, 3000 - 512);
+check_archive ({"a" => [$data . ("\0" x (8192 - 3000))]});
+pass;
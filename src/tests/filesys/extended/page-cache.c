@@ -0,0 +1,71 @@
+/* Checks that file data read once is served from memory after,
+   and that cached pages see every kind of change to the file: an
+   ordinary write across a page boundary, a direct write, and a
+   truncation followed by growth. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+#define FILE_SIZE 8192
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+/* Reads all of FD into BUF and returns the number of device reads
+   it took. */
+static int read_cost(int fd) {
+  int start_cnt, end_cnt;
+  dev_stat(&start_cnt, NULL);
+  seek(fd, 0);
+  if (read(fd, buf, FILE_SIZE) != FILE_SIZE)
+    fail("read of \"a\" failed");
+  dev_stat(&end_cnt, NULL);
+  return end_cnt - start_cnt;
+}
+
+void test_main(void) {
+  int fd, direct_fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+  random_bytes(buf_b, sizeof buf_b);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK((fd = open("a")) > 1, "open \"a\"");
+  CHECK(write(fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+
+  bc_reset();
+  CHECK(read_cost(fd) >= FILE_SIZE / SECTOR_SIZE, "cold read of \"a\" reaches the device");
+  CHECK(read_cost(fd) == 0, "second read of \"a\" is cached");
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  /* A write spanning the two pages updates both. */
+  memcpy(buf_a + 4000, buf_b, 200);
+  seek(fd, 4000);
+  CHECK(write(fd, buf_b, 200) == 200, "write 200 bytes at 4000 in \"a\"");
+  read_cost(fd);
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  /* So does a direct write. */
+  memcpy(buf_a, buf_b + SECTOR_SIZE, SECTOR_SIZE);
+  CHECK((direct_fd = open_direct("a")) > 1, "open_direct \"a\"");
+  CHECK(write(direct_fd, buf_b + SECTOR_SIZE, SECTOR_SIZE) == SECTOR_SIZE,
+        "write sector 0 of \"a\" directly");
+  close(direct_fd);
+  read_cost(fd);
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  /* Truncated bytes do not come back from the cache. */
+  memset(buf_a + 3000, 0, FILE_SIZE - 3000);
+  CHECK(ftruncate(fd, 3000), "ftruncate \"a\" to 3000 bytes");
+  CHECK(ftruncate(fd, FILE_SIZE), "ftruncate \"a\" to 8192 bytes");
+  read_cost(fd);
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  msg("close \"a\"");
+  close(fd);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-cache) begin
+(page-cache) create "a"
+(page-cache) open "a"
+(page-cache) write "a"
+(page-cache) cold read of "a" reaches the device
+(page-cache) second read of "a" is cached
+(page-cache) write 200 bytes at 4000 in "a"
+(page-cache) open_direct "a"
+(page-cache) write sector 0 of "a" directly
+(page-cache) ftruncate "a" to 3000 bytes
+(page-cache) ftruncate "a" to 8192 bytes
+(page-cache) close "a"
+(page-cache) end
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Checks that a sequential reader is served from pages that the
+   read-ahead thread prefetched into the page cache: after the
+   first, cold page, reading each page of a file advised
+   FADV_SEQUENTIAL costs no device reads of its own. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_SECTORS (PAGE_SIZE / 512)
+#define PAGE_CNT 8
+#define FILE_SIZE (PAGE_CNT * PAGE_SIZE)
+
+/* Times to poll the device's read count before giving up on the
+   read-ahead thread. */
+#define WAIT_LIMIT 1000000
+
+static char buf_a[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+/* Returns the number of sectors read from the file system
+   device. */
+static int dev_reads(void) {
+  int read_cnt;
+  dev_stat(&read_cnt, NULL);
+  return read_cnt;
+}
+
+/* Waits until the device has read at least CNT sectors in all,
+   as the read-ahead thread works in the background. */
+static void wait_for_reads(int cnt) {
+  int i;
+  for (i = 0; i < WAIT_LIMIT; i++)
+    if (dev_reads() >= cnt)
+      return;
+  fail("read-ahead never reached the device");
+}
+
+void test_main(void) {
+  int prefetched_cnt = 0;
+  int fd, page;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK((fd = open("a")) > 1, "open \"a\"");
+  CHECK(write(fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+
+  bc_reset();
+  CHECK(fadvise(fd, FADV_SEQUENTIAL), "fadvise \"a\" FADV_SEQUENTIAL");
+  seek(fd, 0);
+  for (page = 0; page < PAGE_CNT; page++) {
+    int start_cnt = dev_reads();
+    if (read(fd, buf + page * PAGE_SIZE, PAGE_SIZE) != PAGE_SIZE)
+      fail("read of page %d of \"a\" failed", page);
+    int end_cnt = dev_reads();
+    if (page > 0 && end_cnt == start_cnt)
+      prefetched_cnt++;
+
+    /* The read queued the next page; let it load. */
+    if (page + 1 < PAGE_CNT)
+      wait_for_reads(end_cnt + PAGE_SECTORS);
+  }
+  CHECK(prefetched_cnt == PAGE_CNT - 1, "pages after the first were read ahead");
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  msg("close \"a\"");
+  close(fd);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readahead-pages) begin
+(readahead-pages) create "a"
+(readahead-pages) open "a"
+(readahead-pages) write "a"
+(readahead-pages) fadvise "a" FADV_SEQUENTIAL
+(readahead-pages) pages after the first were read ahead
+(readahead-pages) close "a"
+(readahead-pages) end
+EOF
+pass;
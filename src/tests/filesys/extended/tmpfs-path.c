@@ -0,0 +1,51 @@
+/* Reaches a file in the memory-backed /tmp file system through
+   relative names, "." and ".." components and repeated slashes,
+   and checks that /tmp cannot become the current directory or a
+   directory on disk. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char data[] = "tmpfs";
+
+/* Opens NAME and checks that it is the file written through
+   "/tmp/a". */
+static void check_tmp_file(const char* name) {
+  char buf[sizeof data];
+  int fd;
+
+  CHECK((fd = open(name)) > 1, "open \"%s\"", name);
+  CHECK(read(fd, buf, sizeof buf) == sizeof buf && !memcmp(buf, data, sizeof buf),
+        "read \"%s\"", name);
+  close(fd);
+}
+
+void test_main(void) {
+  int fd;
+
+  CHECK(create("/tmp/a", 0), "create \"/tmp/a\"");
+  CHECK((fd = open("/tmp/a")) > 1, "open \"/tmp/a\"");
+  CHECK(write(fd, data, sizeof data) == sizeof data, "write \"/tmp/a\"");
+  close(fd);
+
+  check_tmp_file("//tmp/a");
+  check_tmp_file("/tmp/../tmp/a");
+  check_tmp_file("/./tmp/./a");
+  check_tmp_file("tmp/a");
+
+  CHECK(mkdir("b"), "mkdir \"b\"");
+  CHECK(chdir("b"), "chdir \"b\"");
+  check_tmp_file("../tmp/a");
+  CHECK(!create("../tmp/a", 0), "create \"../tmp/a\" (must return false)");
+
+  CHECK(!chdir("/tmp"), "chdir \"/tmp\" (must return false)");
+  CHECK(!chdir("../tmp"), "chdir \"../tmp\" (must return false)");
+  CHECK(!mkdir("/tmp"), "mkdir \"/tmp\" (must return false)");
+  CHECK(!create("/tmp", 0), "create \"/tmp\" (must return false)");
+  CHECK(!remove("/tmp"), "remove \"/tmp\" (must return false)");
+
+  CHECK(remove("../tmp/../tmp/a"), "remove \"../tmp/../tmp/a\"");
+  CHECK(open("/tmp/a") == -1, "open \"/tmp/a\" (must return -1)");
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmpfs-path) begin
+(tmpfs-path) create "/tmp/a"
+(tmpfs-path) open "/tmp/a"
+(tmpfs-path) write "/tmp/a"
+(tmpfs-path) open "//tmp/a"
+(tmpfs-path) read "//tmp/a"
+(tmpfs-path) open "/tmp/../tmp/a"
+(tmpfs-path) read "/tmp/../tmp/a"
+(tmpfs-path) open "/./tmp/./a"
+(tmpfs-path) read "/./tmp/./a"
+(tmpfs-path) open "tmp/a"
+(tmpfs-path) read "tmp/a"
+(tmpfs-path) mkdir "b"
+(tmpfs-path) chdir "b"
+(tmpfs-path) open "../tmp/a"
+(tmpfs-path) read "../tmp/a"
+(tmpfs-path) create "../tmp/a" (must return false)
+(tmpfs-path) chdir "/tmp" (must return false)
+(tmpfs-path) chdir "../tmp" (must return false)
+(tmpfs-path) mkdir "/tmp" (must return false)
+(tmpfs-path) create "/tmp" (must return false)
+(tmpfs-path) remove "/tmp" (must return false)
+(tmpfs-path) remove "../tmp/../tmp/a"
+(tmpfs-path) open "/tmp/a" (must return -1)
+(tmpfs-path) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Writes and reads back a file in the memory-backed /tmp file
+   system, checking that none of it reaches the disk, then removes
+   it. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 10000
+static char buf[FILE_SIZE];
+static char check[FILE_SIZE];
+
+void test_main(void) {
+  int fd;
+  int start_cnt, end_cnt;
+
+  random_init(0);
+  random_bytes(buf, sizeof buf);
+
+  bc_stat(NULL, &start_cnt);
+  CHECK(create("/tmp/a", 0), "create \"/tmp/a\"");
+  CHECK(!create("/tmp/a", 0), "create \"/tmp/a\" again (must return false)");
+  CHECK((fd = open("/tmp/a")) > 1, "open \"/tmp/a\"");
+  CHECK(write(fd, buf, FILE_SIZE) == FILE_SIZE, "write \"/tmp/a\"");
+  CHECK(filesize(fd) == FILE_SIZE, "filesize \"/tmp/a\"");
+  seek(fd, 0);
+  CHECK(read(fd, check, FILE_SIZE) == FILE_SIZE, "read \"/tmp/a\"");
+  compare_bytes(check, buf, FILE_SIZE, 0, "/tmp/a");
+  msg("close \"/tmp/a\"");
+  close(fd);
+  bc_stat(NULL, &end_cnt);
+  CHECK(end_cnt == start_cnt, "no device writes");
+
+  CHECK(remove("/tmp/a"), "remove \"/tmp/a\"");
+  CHECK(open("/tmp/a") == -1, "open \"/tmp/a\" (must return -1)");
+}
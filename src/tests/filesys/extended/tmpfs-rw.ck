@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmpfs-rw) begin
+(tmpfs-rw) create "/tmp/a"
+(tmpfs-rw) create "/tmp/a" again (must return false)
+(tmpfs-rw) open "/tmp/a"
+(tmpfs-rw) write "/tmp/a"
+(tmpfs-rw) filesize "/tmp/a"
+(tmpfs-rw) read "/tmp/a"
+(tmpfs-rw) close "/tmp/a"
+(tmpfs-rw) no device writes
+(tmpfs-rw) remove "/tmp/a"
+(tmpfs-rw) open "/tmp/a" (must return -1)
+(tmpfs-rw) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($a) = random_bytes (70000);
+check_archive ({"a" => [substr ($a, 0, 1000) . ("\0" x 4000)]});
+pass;
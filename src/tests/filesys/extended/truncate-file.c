@@ -0,0 +1,55 @@
+/* Shrinks a file that uses an indirect block with ftruncate(),
+   grows it again with ftruncate() and fallocate(), and checks
+   that the bytes past the old end always read back as zeros. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 70000
+#define BIG_SIZE 80000
+static char buf_a[FILE_SIZE];
+static char expected[BIG_SIZE];
+
+void test_main(void) {
+  int fd, dir_fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK((fd = open("a")) > 1, "open \"a\"");
+  CHECK(write(fd, buf_a, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+
+  CHECK(ftruncate(fd, 1000), "ftruncate \"a\" to 1000 bytes");
+  CHECK(filesize(fd) == 1000, "filesize \"a\" is 1000");
+  CHECK(tell(fd) == FILE_SIZE, "tell \"a\" is unchanged");
+  seek(fd, 0);
+  check_file_handle(fd, "a", buf_a, 1000);
+
+  /* Growing again must not bring back the truncated bytes. */
+  memcpy(expected, buf_a, 1000);
+  CHECK(ftruncate(fd, 3000), "ftruncate \"a\" to 3000 bytes");
+  seek(fd, 0);
+  check_file_handle(fd, "a", expected, 3000);
+
+  CHECK(fallocate(fd, 1000, BIG_SIZE - 1000), "fallocate 80000 bytes of \"a\"");
+  CHECK(filesize(fd) == BIG_SIZE, "filesize \"a\" is 80000");
+  CHECK(fallocate(fd, 0, 100), "fallocate inside \"a\"");
+  CHECK(filesize(fd) == BIG_SIZE, "filesize \"a\" is still 80000");
+  seek(fd, 0);
+  check_file_handle(fd, "a", expected, BIG_SIZE);
+
+  CHECK(ftruncate(fd, 5000), "ftruncate \"a\" to 5000 bytes");
+  CHECK(filesize(fd) == 5000, "filesize \"a\" is 5000");
+
+  CHECK((dir_fd = open("/")) > 1, "open \"/\"");
+  CHECK(!ftruncate(dir_fd, 0), "ftruncate of a directory fails");
+  CHECK(!fallocate(dir_fd, 0, 512), "fallocate of a directory fails");
+  close(dir_fd);
+
+  msg("close \"a\"");
+  close(fd);
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(truncate-file) begin
+(truncate-file) create "a"
+(truncate-file) open "a"
+(truncate-file) write "a"
+(truncate-file) ftruncate "a" to 1000 bytes
+(truncate-file) filesize "a" is 1000
+(truncate-file) tell "a" is unchanged
+(truncate-file) verified contents of "a"
+(truncate-file) ftruncate "a" to 3000 bytes
+(truncate-file) verified contents of "a"
+(truncate-file) fallocate 80000 bytes of "a"
+(truncate-file) filesize "a" is 80000
+(truncate-file) fallocate inside "a"
+(truncate-file) filesize "a" is still 80000
+(truncate-file) verified contents of "a"
+(truncate-file) ftruncate "a" to 5000 bytes
+(truncate-file) filesize "a" is 5000
+(truncate-file) open "/"
+(truncate-file) ftruncate of a directory fails
+(truncate-file) fallocate of a directory fails
+(truncate-file) close "a"
+(truncate-file) end
+EOF
+pass;
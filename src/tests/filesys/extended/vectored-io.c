@@ -0,0 +1,62 @@
+/* Writes a file with writev() and reads it back with readv(),
+   using buffers that do not line up with each other or with
+   sectors, then checks that pread() and pwrite() leave the file
+   position alone. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 6192
+static char buf_a[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+void test_main(void) {
+  struct iovec iov[4];
+  int fd;
+
+  random_init(0);
+  random_bytes(buf_a, sizeof buf_a);
+
+  CHECK(create("a", 0), "create \"a\"");
+  CHECK((fd = open("a")) > 1, "open \"a\"");
+
+  /* Gather the first 6000 bytes from four buffers, one empty. */
+  iov[0].iov_base = buf_a;
+  iov[0].iov_len = 1000;
+  iov[1].iov_base = buf_a + 1000;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = buf_a + 1000;
+  iov[2].iov_len = 3000;
+  iov[3].iov_base = buf_a + 4000;
+  iov[3].iov_len = 2000;
+  CHECK(writev(fd, iov, 4) == 6000, "writev 6000 bytes to \"a\"");
+  CHECK(tell(fd) == 6000, "tell \"a\" after writev");
+
+  /* The rest goes at an explicit offset, leaving the position. */
+  seek(fd, 0);
+  CHECK(pwrite(fd, buf_a + 6000, FILE_SIZE - 6000, 6000) == FILE_SIZE - 6000,
+        "pwrite 192 bytes at 6000 in \"a\"");
+  CHECK(tell(fd) == 0, "tell \"a\" after pwrite");
+
+  /* Scatter the whole file into two buffers. */
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 2500;
+  iov[1].iov_base = buf + 2500;
+  iov[1].iov_len = FILE_SIZE - 2500;
+  CHECK(readv(fd, iov, 2) == FILE_SIZE, "readv 6192 bytes from \"a\"");
+  compare_bytes(buf, buf_a, FILE_SIZE, 0, "a");
+
+  memset(buf, 0, sizeof buf);
+  CHECK(pread(fd, buf, 292, 5900) == 292, "pread 292 bytes at 5900 in \"a\"");
+  CHECK(tell(fd) == FILE_SIZE, "tell \"a\" after pread");
+  compare_bytes(buf, buf_a + 5900, 292, 5900, "a");
+
+  CHECK(readv(fd, iov, IOV_MAX + 1) == -1, "readv with too many buffers fails");
+  CHECK(writev(fd, iov, -1) == -1, "writev with a negative count fails");
+
+  msg("close \"a\"");
+  close(fd);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vectored-io) begin
+(vectored-io) create "a"
+(vectored-io) open "a"
+(vectored-io) writev 6000 bytes to "a"
+(vectored-io) tell "a" after writev
+(vectored-io) pwrite 192 bytes at 6000 in "a"
+(vectored-io) tell "a" after pwrite
+(vectored-io) readv 6192 bytes from "a"
+(vectored-io) pread 292 bytes at 5900 in "a"
+(vectored-io) tell "a" after pread
+(vectored-io) readv with too many buffers fails
+(vectored-io) writev with a negative count fails
+(vectored-io) close "a"
+(vectored-io) end
+EOF
+pass;
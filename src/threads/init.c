@@ -37,8 +37,13 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/raid0.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/tarfs.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -52,6 +57,17 @@ static bool format_filesys;
    overriding the defaults. */
 static const char* filesys_bdev_name;
 static const char* scratch_bdev_name;
+
+/* -mount-tar: Path at which to mount the scratch archive, if any. */
+static const char* tarfs_mount_point;
+
+/* -ramdisk: Size of the RAM disk in kB, or 0 for none. */
+static size_t ramdisk_kb;
+
+/* -raid0, -raid0-chunk: Member devices of the RAID-0 device, if
+   any, and sectors per chunk. */
+static const char* raid0_members;
+static size_t raid0_chunk_cnt = 8;
 #ifdef VM
 static const char* swap_bdev_name;
 #endif
@@ -129,8 +145,17 @@ int main(void) {
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init();
+  virtio_blk_init();
+  ramdisk_init(ramdisk_kb * 1024);
+  if (raid0_members != NULL)
+    raid0_init(raid0_members, raid0_chunk_cnt);
   locate_block_devices();
   filesys_init(format_filesys);
+  if (tarfs_mount_point != NULL) {
+    struct block* scratch = block_get_role(BLOCK_SCRATCH);
+    if (scratch == NULL || !tarfs_mount(scratch, tarfs_mount_point))
+      PANIC("couldn't mount scratch archive at %s", tarfs_mount_point);
+  }
 #endif
 
   // Initialize global file lock
@@ -246,6 +271,18 @@ static char** parse_options(char** argv) {
       filesys_bdev_name = value;
     else if (!strcmp(name, "-scratch"))
       scratch_bdev_name = value;
+    else if (!strcmp(name, "-mount-tar"))
+      tarfs_mount_point = value;
+    else if (!strcmp(name, "-ramdisk"))
+      ramdisk_kb = atoi(value);
+    else if (!strcmp(name, "-raid0"))
+      raid0_members = value;
+    else if (!strcmp(name, "-raid0-chunk"))
+      raid0_chunk_cnt = atoi(value);
+    else if (!strcmp(name, "-iosched")) {
+      if (!iosched_select(value))
+        PANIC("unknown I/O scheduler `%s' (use -h for help)", value);
+    }
 #ifdef VM
     else if (!strcmp(name, "-swap"))
       swap_bdev_name = value;
@@ -426,6 +463,11 @@ static void usage(void) {
          "  -f                 Format file system device during startup.\n"
          "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
          "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+         "  -mount-tar=PATH    Mount ustar archive on scratch read-only at PATH.\n"
+         "  -ramdisk=SIZE      Create RAM disk \"ram0\" of SIZE kB, for use as a BDEV.\n"
+         "  -raid0=BDEV,...    Create RAID-0 device \"md0\" striped across the BDEVs.\n"
+         "  -raid0-chunk=N     Stripe md0 in chunks of N sectors (default: 8).\n"
+         "  -iosched=NAME      Order disk requests by NAME: deadline (default) or noop.\n"
 #ifdef VM
          "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif // VM
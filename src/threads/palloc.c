@@ -35,6 +35,10 @@ struct pool {
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Frees kernel pages held by caches when the kernel pool runs
+   out, or null. */
+static palloc_shrink_func* shrinker;
+
 static void init_pool(struct pool*, void* base, size_t page_cnt, const char* name);
 static bool page_from_pool(const struct pool*, void* page);
 
@@ -61,18 +65,28 @@ void palloc_init(size_t user_page_limit) {
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.  Before giving up on
+   the kernel pool, the shrinker is asked to free pages, unless
+   PAL_NOSHRINK is set. */
 void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
   struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  bool may_shrink = pool == &kernel_pool && !(flags & PAL_NOSHRINK) && shrinker != NULL;
   void* pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire(&pool->lock);
-  page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
-  lock_release(&pool->lock);
+  for (;;) {
+    lock_acquire(&pool->lock);
+    page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+    lock_release(&pool->lock);
+
+    /* Freed pages may not be contiguous, so try until the
+       shrinker has nothing left to give. */
+    if (page_idx != BITMAP_ERROR || !may_shrink || shrinker(page_cnt) == 0)
+      break;
+  }
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -128,6 +142,22 @@ void palloc_free_multiple(void* pages, size_t page_cnt) {
 /* Frees the page at PAGE. */
 void palloc_free_page(void* page) { palloc_free_multiple(page, 1); }
 
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool. */
+size_t palloc_free_cnt(enum palloc_flags flags) {
+  struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t free_cnt;
+
+  lock_acquire(&pool->lock);
+  free_cnt = bitmap_count(pool->used_map, 0, bitmap_size(pool->used_map), false);
+  lock_release(&pool->lock);
+  return free_cnt;
+}
+
+/* Installs SHRINK as the function that palloc_get_multiple()
+   calls to free kernel pages before failing. */
+void palloc_set_shrinker(palloc_shrink_func* shrink) { shrinker = shrink; }
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void init_pool(struct pool* p, void* base, size_t page_cnt, const char* name) {
@@ -5,15 +5,23 @@
 
 /* How to allocate pages. */
 enum palloc_flags {
-  PAL_ASSERT = 001, /* Panic on failure. */
-  PAL_ZERO = 002,   /* Zero page contents. */
-  PAL_USER = 004    /* User page. */
+  PAL_ASSERT = 001,  /* Panic on failure. */
+  PAL_ZERO = 002,    /* Zero page contents. */
+  PAL_USER = 004,    /* User page. */
+  PAL_NOSHRINK = 010 /* Fail rather than call the shrinker. */
 };
 
+/* Called when the kernel pool cannot satisfy a request for
+   PAGE_CNT pages.  Should free unneeded pages, without sleeping
+   on any lock, and return how many it freed. */
+typedef size_t palloc_shrink_func(size_t page_cnt);
+
 void palloc_init(size_t user_page_limit);
 void* palloc_get_page(enum palloc_flags);
 void* palloc_get_multiple(enum palloc_flags, size_t page_cnt);
 void palloc_free_page(void*);
 void palloc_free_multiple(void*, size_t page_cnt);
+size_t palloc_free_cnt(enum palloc_flags);
+void palloc_set_shrinker(palloc_shrink_func*);
 
 #endif /* threads/palloc.h */
@@ -98,6 +98,11 @@ struct thread {
   struct process* pcb; /* Process control block if this thread is a userprog */
 #endif
 
+#ifdef FILESYS
+  /* Owned by filesys/journal.c. */
+  int journal_depth; /* Nesting depth of running journal transactions. */
+#endif
+
   /* Owned by thread.c. */
   unsigned magic; /* Detects stack overflow. */
 };
@@ -1,5 +1,8 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <blkstat.h>
+#include <iovec.h>
+#include <limits.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -17,6 +20,9 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
 
 static void syscall_handler(struct intr_frame*);
 
@@ -40,7 +46,7 @@ static int next_fd(void);
 // File operations
 static void syscall_create(struct intr_frame* f, const char* file, unsigned initial_size);
 static void syscall_remove(struct intr_frame* f, const char* file);
-static void syscall_open(struct intr_frame* f, const char* file_name);
+static void syscall_open(struct intr_frame* f, const char* file_name, bool direct);
 static void syscall_filesize(struct intr_frame* f, int fd);
 static void syscall_read(struct intr_frame* f, int fd, char* buffer, unsigned length);
 static void syscall_write(struct intr_frame* f, int fd, const char* buffer, unsigned length);
@@ -61,6 +67,29 @@ static void syscall_isdir(struct intr_frame* f, int fd);
 static void syscall_bc_reset(void);
 static void syscall_bc_stat(float* hit_rate_cnt_ptr, int* block_write_cnt_ptr);
 
+// Durability
+static void syscall_fsync(struct intr_frame* f, int fd, bool data_only);
+static void syscall_defrag(struct intr_frame* f, int fd);
+static void syscall_fadvise(struct intr_frame* f, int fd, int advice);
+
+// Benchmarking
+static void syscall_dev_stat(int* read_cnt_ptr, int* write_cnt_ptr);
+static void syscall_blk_stat(struct intr_frame* f, const char* dev, struct blkstat* st);
+
+// Vectored and positional I/O
+static int copy_in_iovec(struct iovec* kiov, const struct iovec* iov, int iovcnt);
+static void syscall_readv(struct intr_frame* f, int fd, const struct iovec* iov, int iovcnt);
+static void syscall_writev(struct intr_frame* f, int fd, const struct iovec* iov, int iovcnt);
+static void syscall_pread(struct intr_frame* f, int fd, void* buffer, unsigned length,
+                          unsigned position);
+static void syscall_pwrite(struct intr_frame* f, int fd, const void* buffer, unsigned length,
+                           unsigned position);
+static void syscall_copy_file_range(struct intr_frame* f, int fd_in, int fd_out, unsigned length);
+
+// File space
+static void syscall_ftruncate(struct intr_frame* f, int fd, unsigned length);
+static void syscall_fallocate(struct intr_frame* f, int fd, unsigned offset, unsigned length);
+
 void syscall_init(void) { intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall"); }
 
 static void syscall_handler(struct intr_frame* f UNUSED) {
@@ -127,13 +156,14 @@ static void syscall_handler(struct intr_frame* f UNUSED) {
       free(file);
       break;
     }
-    case SYS_OPEN: {
+    case SYS_OPEN:
+    case SYS_OPEN_DIRECT: {
       if (!valid_pointer((uint8_t*)&(args[1]), sizeof(char*)))
         process_exit();
       char* file = valid_str_pointer((char*)args[1]);
       if (!file)
         process_exit();
-      syscall_open(f, file);
+      syscall_open(f, file, syscall_type == SYS_OPEN_DIRECT);
       free(file);
       break;
     }
@@ -256,6 +286,124 @@ static void syscall_handler(struct intr_frame* f UNUSED) {
       syscall_bc_stat(hit_rate_cnt_ptr, block_write_cnt_ptr);
       break;
     }
+    case SYS_FSYNC:
+    case SYS_FDATASYNC: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      syscall_fsync(f, args[1], syscall_type == SYS_FDATASYNC);
+      break;
+    }
+    case SYS_TICKS: {
+      f->eax = timer_ticks();
+      break;
+    }
+    case SYS_DEV_STAT: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int*)))
+        process_exit();
+      int* read_cnt_ptr = (int*)args[1];
+      if (read_cnt_ptr && !valid_pointer((uint8_t*)read_cnt_ptr, sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(int*)))
+        process_exit();
+      int* write_cnt_ptr = (int*)args[2];
+      if (write_cnt_ptr && !valid_pointer((uint8_t*)write_cnt_ptr, sizeof(int)))
+        process_exit();
+      syscall_dev_stat(read_cnt_ptr, write_cnt_ptr);
+      break;
+    }
+    case SYS_DEFRAG: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      syscall_defrag(f, args[1]);
+      break;
+    }
+    case SYS_FADVISE: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(int)))
+        process_exit();
+      syscall_fadvise(f, args[1], args[2]);
+      break;
+    }
+    case SYS_READV:
+    case SYS_WRITEV: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(struct iovec*)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[3]), sizeof(int)))
+        process_exit();
+      if (syscall_type == SYS_READV)
+        syscall_readv(f, args[1], (const struct iovec*)args[2], args[3]);
+      else
+        syscall_writev(f, args[1], (const struct iovec*)args[2], args[3]);
+      break;
+    }
+    case SYS_PREAD:
+    case SYS_PWRITE: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(void*)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[3]), sizeof(unsigned)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[4]), sizeof(unsigned)))
+        process_exit();
+      void* buffer = (void*)args[2];
+      unsigned length = args[3];
+      if (length > 0 && !valid_pointer((uint8_t*)buffer, length))
+        process_exit();
+      if (syscall_type == SYS_PREAD)
+        syscall_pread(f, args[1], buffer, length, args[4]);
+      else
+        syscall_pwrite(f, args[1], buffer, length, args[4]);
+      break;
+    }
+    case SYS_COPY_FILE_RANGE: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[3]), sizeof(unsigned)))
+        process_exit();
+      syscall_copy_file_range(f, args[1], args[2], args[3]);
+      break;
+    }
+    case SYS_FTRUNCATE: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(unsigned)))
+        process_exit();
+      syscall_ftruncate(f, args[1], args[2]);
+      break;
+    }
+    case SYS_FALLOCATE: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(int)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(unsigned)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[3]), sizeof(unsigned)))
+        process_exit();
+      syscall_fallocate(f, args[1], args[2], args[3]);
+      break;
+    }
+    case SYS_BLK_STAT: {
+      if (!valid_pointer((uint8_t*)&(args[1]), sizeof(char*)))
+        process_exit();
+      if (!valid_pointer((uint8_t*)&(args[2]), sizeof(struct blkstat*)))
+        process_exit();
+      char* dev = NULL;
+      if (args[1] != 0 && (dev = valid_str_pointer((char*)args[1])) == NULL)
+        process_exit();
+      struct blkstat* st = (struct blkstat*)args[2];
+      if (!valid_pointer((uint8_t*)st, sizeof *st)) {
+        free(dev);
+        process_exit();
+      }
+      syscall_blk_stat(f, dev, st);
+      free(dev);
+      break;
+    }
   }
 }
 
@@ -384,7 +532,7 @@ static void syscall_remove(struct intr_frame* f, const char* file) {
 
 /* Opens the file with name FILE_NAME.
    Returns the new file descriptor if successful or -1 otherwise. */
-static void syscall_open(struct intr_frame* f, const char* file_name) {
+static void syscall_open(struct intr_frame* f, const char* file_name, bool direct) {
   // Open file
   struct file* file = filesys_open(file_name);
   if (file == NULL) {
@@ -392,6 +540,16 @@ static void syscall_open(struct intr_frame* f, const char* file_name) {
     return;
   }
 
+  // Only regular files may bypass the buffer cache
+  if (direct) {
+    if (inode_isdir(file_get_inode(file))) {
+      file_close(file);
+      f->eax = -1;
+      return;
+    }
+    file_set_direct(file, true);
+  }
+
   // New FDT entry
   struct fdt_entry* fdt_entry = malloc(sizeof(struct fdt_entry));
   if (fdt_entry == NULL) {
@@ -532,6 +690,13 @@ static void syscall_inumber(struct intr_frame* f, int fd) {
 /* Change current working directory to DIR. */
 static void syscall_chdir(struct intr_frame* f, char* dir) {
   struct process* pcb = thread_current()->pcb;
+
+  /* A mount point is not a directory of the disk file system. */
+  if (filesys_in_mount(dir)) {
+    f->eax = false;
+    return;
+  }
+
   struct dir* new_cwd = dir_open(dir_resolve_path(dir));
   if (!new_cwd) { /* Invalid directory. */
     f->eax = false;
@@ -542,13 +707,12 @@ static void syscall_chdir(struct intr_frame* f, char* dir) {
   f->eax = true;
 }
 
-/* Create a directory named DIR. */
-static void syscall_mkdir(struct intr_frame* f, char* dir) {
-  /* Check for empty directory name. */
-  if (dir[0] == '\0') {
-    f->eax = false;
-    return;
-  }
+/* Create a directory named DIR. Returns true if successful, false otherwise. */
+static bool do_mkdir(char* dir) {
+  /* Check for empty directory name, or one that would shadow or
+     lie below a mount point. */
+  if (dir[0] == '\0' || filesys_in_mount(dir))
+    return false;
 
   /* Determine path type. */
   bool absolute_path = dir[0] == '/';
@@ -573,19 +737,18 @@ static void syscall_mkdir(struct intr_frame* f, char* dir) {
   if (dir_lookup(parent_dir, dir_name, &inode_temp_p)) { /* Name already exists in directory. */
     inode_close(inode_temp_p);
     dir_close(parent_dir);
-    f->eax = false;
-    return;
+    return false;
   }
 
   /* Create new directory. */
   block_sector_t dir_block;
   if (!free_map_allocate(1, &dir_block)) {
     dir_close(parent_dir);
-    return;
+    return false;
   } else if (!dir_create(dir_block, 16)) {
     free_map_release(dir_block, 1);
     dir_close(parent_dir);
-    return;
+    return false;
   }
 
   /* Setup new directory. */
@@ -595,11 +758,24 @@ static void syscall_mkdir(struct intr_frame* f, char* dir) {
   inode_set_isdir(dir_get_inode(new_dir), true);
   dir_close(new_dir);
 
-  /* Add directory to parent. */
-  dir_add(parent_dir, dir_name, dir_block);
+  /* Add directory to parent, which fails if the parent has been
+     removed in the meantime.  The new directory is then freed. */
+  bool success = dir_add(parent_dir, dir_name, dir_block);
   dir_close(parent_dir);
+  if (!success) {
+    struct inode* inode = inode_open(dir_block);
+    inode_remove(inode);
+    inode_close(inode);
+  }
 
-  f->eax = true;
+  return success;
+}
+
+/* Create a directory named DIR, as one journal transaction. */
+static void syscall_mkdir(struct intr_frame* f, char* dir) {
+  journal_begin();
+  f->eax = do_mkdir(dir);
+  journal_end();
 }
 
 /* Read entry from directory corresponding to FD, storing entry's name into NAME. */
@@ -630,7 +806,10 @@ static void syscall_isdir(struct intr_frame* f, int fd) {
   f->eax = fdt_entry != NULL && fdt_entry->dir != NULL;
 }
 
-static void syscall_bc_reset(void) { buffer_cache_reset(); }
+static void syscall_bc_reset(void) {
+  journal_commit();
+  buffer_cache_reset();
+}
 
 static void syscall_bc_stat(float* hit_rate_cnt_ptr, int* block_write_cnt_ptr) {
   if (hit_rate_cnt_ptr) {
@@ -640,3 +819,276 @@ static void syscall_bc_stat(float* hit_rate_cnt_ptr, int* block_write_cnt_ptr) {
     *block_write_cnt_ptr = block_write_cnt(fs_device);
   }
 }
+
+static void syscall_dev_stat(int* read_cnt_ptr, int* write_cnt_ptr) {
+  if (read_cnt_ptr) {
+    *read_cnt_ptr = block_read_cnt(fs_device);
+  }
+  if (write_cnt_ptr) {
+    *write_cnt_ptr = block_write_cnt(fs_device);
+  }
+}
+
+/* Copies the request statistics of the block device named DEV,
+   or of the file system device if DEV is null, into ST.  Returns
+   false if there is no such device. */
+static void syscall_blk_stat(struct intr_frame* f, const char* dev, struct blkstat* st) {
+  struct block* block = dev != NULL ? block_get_by_name(dev) : fs_device;
+  if (block == NULL) {
+    f->eax = false;
+    return;
+  }
+  block_get_stats(block, st);
+  f->eax = true;
+}
+
+/* Writes the dirty blocks of the file or directory open as FD to disk.
+   If DATA_ONLY, the inode is written only if its length changed.
+   Returns false if FD is not open. */
+static void syscall_fsync(struct intr_frame* f, int fd, bool data_only) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL) {
+    f->eax = false;
+    return;
+  }
+  if (fdt_entry->file)
+    inode_sync(file_get_inode(fdt_entry->file), data_only);
+  else
+    inode_sync(dir_get_inode(fdt_entry->dir), data_only);
+  f->eax = true;
+}
+
+/* Moves the data blocks of the file open as FD into contiguous
+   runs.  Returns the number of blocks moved, or -1 if FD is not
+   an open regular file. */
+static void syscall_defrag(struct intr_frame* f, int fd) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL) {
+    f->eax = -1;
+    return;
+  }
+  f->eax = inode_defrag(file_get_inode(fdt_entry->file));
+}
+
+/* Tells the buffer cache how the file open as FD will be read,
+   from its current position.  Returns false if FD is not an open
+   regular file or ADVICE is not a known hint. */
+static void syscall_fadvise(struct intr_frame* f, int fd, int advice) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL || advice < ADVICE_NORMAL ||
+      advice > ADVICE_NOREUSE) {
+    f->eax = false;
+    return;
+  }
+  inode_advise(file_get_inode(fdt_entry->file), advice, file_tell(fdt_entry->file));
+  f->eax = true;
+}
+
+/* Copies the IOVCNT iovecs at user address IOV into KIOV, which
+   must have room for IOV_MAX of them, after checking that the
+   array and every buffer it names are valid user memory.  Taking
+   a copy keeps other threads from changing the request after it
+   has been checked.  Returns the total length of the buffers, or
+   -1 if IOVCNT is out of range or the total overflows an int.
+   Terminates the process if any pointer is bad. */
+static int copy_in_iovec(struct iovec* kiov, const struct iovec* iov, int iovcnt) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  if (iovcnt == 0)
+    return 0;
+  if (!valid_pointer((uint8_t*)iov, iovcnt * sizeof *iov))
+    process_exit();
+  memcpy(kiov, iov, iovcnt * sizeof *iov);
+
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    if (kiov[i].iov_len == 0)
+      continue;
+    if (!valid_pointer(kiov[i].iov_base, kiov[i].iov_len))
+      process_exit();
+    if (kiov[i].iov_len > (size_t)INT_MAX - total)
+      return -1;
+    total += kiov[i].iov_len;
+  }
+  return total;
+}
+
+/* Copies SIZE bytes between BOUNCE and the buffers of IOV,
+   starting *OFS bytes into their concatenation, and advances *OFS
+   past them.  Copies into the buffers if SCATTER is true, out of
+   them otherwise. */
+static void iovec_copy(const struct iovec* iov, size_t* ofs, uint8_t* bounce, size_t size,
+                       bool scatter) {
+  size_t skip = *ofs;
+  *ofs += size;
+  for (; size > 0; iov++) {
+    if (skip >= iov->iov_len) {
+      skip -= iov->iov_len;
+      continue;
+    }
+    uint8_t* base = (uint8_t*)iov->iov_base + skip;
+    size_t chunk_size = iov->iov_len - skip < size ? iov->iov_len - skip : size;
+    if (scatter)
+      memcpy(base, bounce, chunk_size);
+    else
+      memcpy(bounce, base, chunk_size);
+    bounce += chunk_size;
+    size -= chunk_size;
+    skip = 0;
+  }
+}
+
+/* Reads from the file open as FD into the IOVCNT buffers of IOV,
+   in order, starting at the file's position.  The file is read a
+   page at a time into a kernel buffer, so each page costs one
+   pass through the inode however many buffers it covers.  Returns
+   the number of bytes read, or -1 if FD is not open for reading
+   or IOVCNT is out of range. */
+static void syscall_readv(struct intr_frame* f, int fd, const struct iovec* iov, int iovcnt) {
+  struct iovec kiov[IOV_MAX];
+  int length = copy_in_iovec(kiov, iov, iovcnt);
+  if (length < 0 || fd == STDOUT_FILENO) {
+    f->eax = -1;
+    return;
+  }
+
+  if (fd == STDIN_FILENO) {
+    for (int i = 0; i < iovcnt; i++)
+      for (size_t j = 0; j < kiov[i].iov_len; j++)
+        ((uint8_t*)kiov[i].iov_base)[j] = input_getc();
+    f->eax = length;
+    return;
+  }
+
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  uint8_t* bounce = length > 0 ? palloc_get_page(0) : NULL;
+  if (fdt_entry == NULL || fdt_entry->dir != NULL || (length > 0 && bounce == NULL)) {
+    palloc_free_page(bounce);
+    f->eax = -1;
+    return;
+  }
+
+  size_t bytes_read = 0;
+  while ((int)bytes_read < length) {
+    off_t chunk_size = length - bytes_read < PGSIZE ? length - bytes_read : PGSIZE;
+    off_t n = file_read(fdt_entry->file, bounce, chunk_size);
+    iovec_copy(kiov, &bytes_read, bounce, n, true);
+    if (n < chunk_size)
+      break;
+  }
+  palloc_free_page(bounce);
+  f->eax = bytes_read;
+}
+
+/* Writes the IOVCNT buffers of IOV, in order, to the file open as
+   FD, starting at the file's position.  The buffers are gathered
+   a page at a time into a kernel buffer, so each page costs one
+   pass through the inode.  Returns the number of bytes written,
+   or -1 if FD is not open for writing or IOVCNT is out of
+   range. */
+static void syscall_writev(struct intr_frame* f, int fd, const struct iovec* iov, int iovcnt) {
+  struct iovec kiov[IOV_MAX];
+  int length = copy_in_iovec(kiov, iov, iovcnt);
+  if (length < 0 || fd == STDIN_FILENO) {
+    f->eax = -1;
+    return;
+  }
+
+  if (fd == STDOUT_FILENO) {
+    for (int i = 0; i < iovcnt; i++)
+      putbuf(kiov[i].iov_base, kiov[i].iov_len);
+    f->eax = length;
+    return;
+  }
+
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  uint8_t* bounce = length > 0 ? palloc_get_page(0) : NULL;
+  if (fdt_entry == NULL || fdt_entry->dir != NULL || (length > 0 && bounce == NULL)) {
+    palloc_free_page(bounce);
+    f->eax = -1;
+    return;
+  }
+
+  size_t gathered = 0;
+  size_t bytes_written = 0;
+  while ((int)gathered < length) {
+    off_t chunk_size = length - gathered < PGSIZE ? length - gathered : PGSIZE;
+    iovec_copy(kiov, &gathered, bounce, chunk_size, false);
+    off_t n = file_write(fdt_entry->file, bounce, chunk_size);
+    bytes_written += n;
+    if (n < chunk_size)
+      break;
+  }
+  palloc_free_page(bounce);
+  f->eax = bytes_written;
+}
+
+/* Reads LENGTH bytes into BUFFER from the file open as FD,
+   starting at byte POSITION, without moving the file's position.
+   Returns the number of bytes read, or -1 if FD is not an open
+   regular file or POSITION is past the largest file offset. */
+static void syscall_pread(struct intr_frame* f, int fd, void* buffer, unsigned length,
+                          unsigned position) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL || position > INT_MAX || length > INT_MAX) {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_read_at(fdt_entry->file, buffer, length, position);
+}
+
+/* Writes LENGTH bytes from BUFFER to the file open as FD,
+   starting at byte POSITION, without moving the file's position.
+   Returns the number of bytes written, or -1 if FD is not an open
+   regular file or POSITION is past the largest file offset. */
+static void syscall_pwrite(struct intr_frame* f, int fd, const void* buffer, unsigned length,
+                           unsigned position) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL || position > INT_MAX || length > INT_MAX) {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_write_at(fdt_entry->file, buffer, length, position);
+}
+
+/* Copies up to LENGTH bytes from the file open as FD_IN to the
+   file open as FD_OUT, starting at and advancing both files'
+   positions, without passing the data through user memory.
+   Returns the number of bytes copied, which is 0 at end of file,
+   or -1 if either descriptor is not an open regular file. */
+static void syscall_copy_file_range(struct intr_frame* f, int fd_in, int fd_out,
+                                    unsigned length) {
+  struct fdt_entry* in = get_fdt_entry(fd_in);
+  struct fdt_entry* out = get_fdt_entry(fd_out);
+  if (in == NULL || in->file == NULL || out == NULL || out->file == NULL) {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_copy(out->file, in->file, length > INT_MAX ? INT_MAX : length);
+}
+
+/* Sets the length of the file open as FD to LENGTH bytes,
+   discarding data past it or adding zeros.  The file position is
+   unchanged.  Returns false if FD is not an open regular file or
+   the file cannot be resized. */
+static void syscall_ftruncate(struct intr_frame* f, int fd, unsigned length) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL || length > INT_MAX) {
+    f->eax = false;
+    return;
+  }
+  f->eax = inode_truncate(file_get_inode(fdt_entry->file), length);
+}
+
+/* Reserves disk space for LENGTH bytes of the file open as FD
+   starting at OFFSET, extending the file with zeros if needed.
+   Returns false if FD is not an open regular file or the space
+   cannot be reserved. */
+static void syscall_fallocate(struct intr_frame* f, int fd, unsigned offset, unsigned length) {
+  struct fdt_entry* fdt_entry = get_fdt_entry(fd);
+  if (fdt_entry == NULL || fdt_entry->file == NULL || offset > INT_MAX || length > INT_MAX) {
+    f->eax = false;
+    return;
+  }
+  f->eax = inode_allocate(file_get_inode(fdt_entry->file), offset, length);
+}
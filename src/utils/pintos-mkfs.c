@@ -0,0 +1,364 @@
+/* pintos-mkfs: builds a Pintos file system image on the host.
+
+   The image is written directly in the on-disk format of
+   filesys/inode.c, filesys/directory.c, filesys/free-map.c and
+   filesys/journal.c, so that a kernel booted with it (through
+   `pintos --filesys=IMAGE' or `pintos-mkdisk --filesys=IMAGE')
+   can mount it right away, without formatting with -f or
+   extracting files from the scratch disk.
+
+   Files are copied in as given on the command line.  A guest
+   name containing slashes creates the intermediate directories.
+   Like the rest of Pintos, the image is little-endian. */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match devices/block.h and filesys/. */
+#define SECTOR_SIZE 512
+#define FREE_MAP_SECTOR 0
+#define ROOT_DIR_SECTOR 1
+#define JOURNAL_SECTOR 2
+#define JOURNAL_SECTORS 128
+#define JOURNAL_MAGIC 0x4a524e4c
+#define INODE_MAGIC 0x494e4f44
+#define INODE_NUM_DP 123
+#define PTRS_PER_SECTOR 128
+#define NAME_MAX 14
+#define DIR_ENTRY_SIZE 20
+#define DIR_MIN_ENTRIES 16
+
+/* Most data sectors a single inode can address. */
+#define INODE_MAX_SECTORS (INODE_NUM_DP + PTRS_PER_SECTOR + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
+/* A file or directory to be written to the image. */
+struct node {
+  char name[NAME_MAX + 1]; /* Name within the parent directory. */
+  bool is_dir;             /* Directory or regular file? */
+  uint32_t sector;         /* Inode sector. */
+  uint8_t* data;           /* File contents. */
+  size_t length;           /* Length of DATA in bytes. */
+  struct node* parent;     /* Containing directory. */
+  struct node* children;   /* First entry, if a directory. */
+  struct node* next;       /* Next entry in the same directory. */
+};
+
+static uint8_t* image;       /* Image contents. */
+static uint32_t sector_cnt;  /* Number of sectors in the image. */
+static uint8_t* free_map;    /* One bit per sector, as in lib/kernel/bitmap.c. */
+static size_t free_map_size; /* Size of the free map file in bytes. */
+
+static void fail(const char* msg, ...) __attribute__((noreturn))
+__attribute__((format(printf, 1, 2)));
+
+/* Prints MSG, formatting as with printf(), and exits. */
+static void fail(const char* msg, ...) {
+  va_list args;
+
+  va_start(args, msg);
+  fprintf(stderr, "pintos-mkfs: ");
+  vfprintf(stderr, msg, args);
+  va_end(args);
+  putc('\n', stderr);
+  exit(EXIT_FAILURE);
+}
+
+static void* xcalloc(size_t cnt, size_t size) {
+  void* p = calloc(cnt, size);
+  if (p == NULL)
+    fail("out of memory");
+  return p;
+}
+
+/* Stores VALUE at P in little-endian byte order. */
+static void put_u32(uint8_t* p, uint32_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+/* Returns a pointer to the contents of SECTOR. */
+static uint8_t* sector_ptr(uint32_t sector) { return image + (size_t)sector * SECTOR_SIZE; }
+
+/* Marks SECTOR used in the free map. */
+static void mark(uint32_t sector) { free_map[sector / 8] |= 1 << (sector % 8); }
+
+static bool is_marked(uint32_t sector) { return free_map[sector / 8] & (1 << (sector % 8)); }
+
+/* Allocates CNT consecutive sectors, first fit, as
+   free_map_allocate() does, and returns the first. */
+static uint32_t allocate(uint32_t cnt) {
+  for (uint32_t start = 0; start + cnt <= sector_cnt; start++) {
+    uint32_t i;
+    for (i = 0; i < cnt && !is_marked(start + i); i++)
+      continue;
+    if (i == cnt) {
+      for (i = 0; i < cnt; i++)
+        mark(start + i);
+      return start;
+    }
+    start += i;
+  }
+  fail("image is full");
+}
+
+/* Writes LENGTH bytes of DATA into fresh data blocks and the
+   inode at SECTOR, laid out as inode_file_resize() does. */
+static void write_inode(uint32_t sector, const uint8_t* data, size_t length, bool is_dir) {
+  size_t data_sectors = (length + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  uint8_t* inode = sector_ptr(sector);
+  uint8_t* ip = NULL;
+  uint8_t* dip = NULL;
+
+  if (data_sectors > INODE_MAX_SECTORS)
+    fail("file of %zu bytes is too large", length);
+
+  memset(inode, 0, SECTOR_SIZE);
+  put_u32(inode, length);
+  put_u32(inode + 4, is_dir);
+  put_u32(inode + 508, INODE_MAGIC);
+
+  for (size_t i = 0; i < data_sectors; i++) {
+    uint8_t* slot;
+    if (i < INODE_NUM_DP)
+      slot = inode + 8 + 4 * i;
+    else if (i < INODE_NUM_DP + PTRS_PER_SECTOR) {
+      if (ip == NULL) {
+        uint32_t ip_sector = allocate(1);
+        put_u32(inode + 8 + 4 * INODE_NUM_DP, ip_sector);
+        ip = sector_ptr(ip_sector);
+      }
+      slot = ip + 4 * (i - INODE_NUM_DP);
+    } else {
+      size_t ofs = i - INODE_NUM_DP - PTRS_PER_SECTOR;
+      if (dip == NULL) {
+        uint32_t dip_sector = allocate(1);
+        put_u32(inode + 8 + 4 * (INODE_NUM_DP + 1), dip_sector);
+        dip = sector_ptr(dip_sector);
+      }
+      if (ofs % PTRS_PER_SECTOR == 0) {
+        uint32_t ip_sector = allocate(1);
+        put_u32(dip + 4 * (ofs / PTRS_PER_SECTOR), ip_sector);
+        ip = sector_ptr(ip_sector);
+      }
+      slot = ip + 4 * (ofs % PTRS_PER_SECTOR);
+    }
+
+    uint32_t block = allocate(1);
+    size_t chunk = length - i * SECTOR_SIZE;
+    if (chunk > SECTOR_SIZE)
+      chunk = SECTOR_SIZE;
+    put_u32(slot, block);
+    if (data != NULL)
+      memcpy(sector_ptr(block), data + i * SECTOR_SIZE, chunk);
+  }
+}
+
+/* Appends an in-use entry for NAME at SECTOR to directory contents P. */
+static uint8_t* put_entry(uint8_t* p, const char* name, uint32_t sector) {
+  put_u32(p, sector);
+  strncpy((char*)p + 4, name, NAME_MAX + 1);
+  p[4 + NAME_MAX + 1] = 1;
+  return p + DIR_ENTRY_SIZE;
+}
+
+/* Returns the child of DIR named NAME, or a null pointer. */
+static struct node* find_child(struct node* dir, const char* name) {
+  for (struct node* n = dir->children; n != NULL; n = n->next)
+    if (!strcmp(n->name, name))
+      return n;
+  return NULL;
+}
+
+/* Adds a new child named NAME to DIR and returns it. */
+static struct node* add_child(struct node* dir, const char* name, bool is_dir) {
+  struct node* n = xcalloc(1, sizeof *n);
+  strcpy(n->name, name);
+  n->is_dir = is_dir;
+  n->parent = dir;
+
+  /* Keep entries in command-line order. */
+  struct node** tail = &dir->children;
+  while (*tail != NULL)
+    tail = &(*tail)->next;
+  *tail = n;
+  return n;
+}
+
+/* Reads host file HOST_NAME into a node at GUEST_NAME below ROOT. */
+static void add_file(struct node* root, char* guest_name, const char* host_name) {
+  struct node* dir = root;
+  char* save_ptr;
+  char* part = strtok_r(guest_name, "/", &save_ptr);
+  if (part == NULL)
+    fail("%s: empty file name", host_name);
+
+  for (;;) {
+    char* next = strtok_r(NULL, "/", &save_ptr);
+    if (strlen(part) > NAME_MAX)
+      fail("%s: name component \"%s\" is longer than %d characters", host_name, part, NAME_MAX);
+    if (!strcmp(part, ".") || !strcmp(part, ".."))
+      fail("%s: \".\" and \"..\" are not allowed in file names", host_name);
+
+    struct node* n = find_child(dir, part);
+    if (next == NULL) {
+      if (n != NULL)
+        fail("%s: \"%s\" already exists", host_name, part);
+      n = add_child(dir, part, false);
+
+      FILE* f = fopen(host_name, "rb");
+      if (f == NULL)
+        fail("%s: open: %s", host_name, strerror(errno));
+      size_t capacity = SECTOR_SIZE;
+      n->data = xcalloc(1, capacity);
+      size_t cnt;
+      while ((cnt = fread(n->data + n->length, 1, capacity - n->length, f)) > 0) {
+        n->length += cnt;
+        if (n->length == capacity) {
+          capacity *= 2;
+          n->data = realloc(n->data, capacity);
+          if (n->data == NULL)
+            fail("out of memory");
+        }
+      }
+      if (ferror(f))
+        fail("%s: read: %s", host_name, strerror(errno));
+      fclose(f);
+      return;
+    }
+
+    if (n == NULL)
+      n = add_child(dir, part, true);
+    else if (!n->is_dir)
+      fail("%s: \"%s\" is not a directory", host_name, part);
+    dir = n;
+    part = next;
+  }
+}
+
+/* Allocates inode sectors for DIR's children, then writes DIR and
+   all of its descendants to the image. */
+static void write_tree(struct node* dir) {
+  size_t entry_cnt = 2;
+  for (struct node* n = dir->children; n != NULL; n = n->next) {
+    n->sector = allocate(1);
+    entry_cnt++;
+  }
+
+  /* Directories start with room for DIR_MIN_ENTRIES entries, as
+     dir_create() callers ask for, and grow as needed. */
+  size_t length = (entry_cnt < DIR_MIN_ENTRIES ? DIR_MIN_ENTRIES : entry_cnt) * DIR_ENTRY_SIZE;
+  uint8_t* entries = xcalloc(1, length);
+  uint8_t* p = put_entry(entries, ".", dir->sector);
+  p = put_entry(p, "..", dir->parent->sector);
+  for (struct node* n = dir->children; n != NULL; n = n->next)
+    p = put_entry(p, n->name, n->sector);
+  write_inode(dir->sector, entries, length, true);
+  free(entries);
+
+  for (struct node* n = dir->children; n != NULL; n = n->next) {
+    if (n->is_dir)
+      write_tree(n);
+    else
+      write_inode(n->sector, n->data, n->length, false);
+  }
+}
+
+static void usage(int exit_code) {
+  printf("pintos-mkfs, a utility for building Pintos file system images\n"
+         "Usage: pintos-mkfs [--size=MB] IMAGE [FILE | NAME=FILE]...\n"
+         "where IMAGE is the file system image to create, to be used\n"
+         "with `pintos --filesys=IMAGE' and booted without -f,\n"
+         "  and each FILE is copied into the root directory, or to\n"
+         "      NAME if given, creating directories along the way.\n"
+         "Options:\n"
+         "  --size=MB     Image size in MB (default: 2)\n"
+         "  -h, --help    Display this help message.\n");
+  exit(exit_code);
+}
+
+int main(int argc, char* argv[]) {
+  double size_mb = 2;
+  int argi = 1;
+
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    if (!strcmp(argv[argi], "-h") || !strcmp(argv[argi], "--help"))
+      usage(EXIT_SUCCESS);
+    else if (!strncmp(argv[argi], "--size=", 7)) {
+      char* end;
+      size_mb = strtod(argv[argi] + 7, &end);
+      if (*end != '\0' || size_mb <= 0)
+        fail("%s: invalid size", argv[argi] + 7);
+    } else
+      usage(EXIT_FAILURE);
+  }
+  if (argi >= argc)
+    usage(EXIT_FAILURE);
+  const char* image_name = argv[argi++];
+
+  sector_cnt = size_mb * 1024 * 1024 / SECTOR_SIZE;
+  if (sector_cnt < JOURNAL_SECTORS + 8)
+    fail("image of %u sectors is too small", sector_cnt);
+  image = xcalloc(sector_cnt, SECTOR_SIZE);
+
+  /* Free map of bitmap_file_size() bytes, in whole words. */
+  free_map_size = (sector_cnt + 31) / 32 * 4;
+  free_map = xcalloc(1, free_map_size);
+  if (free_map_size > INODE_NUM_DP * SECTOR_SIZE)
+    fail("image of %u sectors is too large", sector_cnt);
+  mark(FREE_MAP_SECTOR);
+  mark(ROOT_DIR_SECTOR);
+  mark(JOURNAL_SECTOR);
+
+  /* Lay out the free map file and the log first, as do_format()
+     does. */
+  write_inode(FREE_MAP_SECTOR, NULL, free_map_size, false);
+  uint32_t log_start = allocate(JOURNAL_SECTORS);
+  uint8_t* header = sector_ptr(JOURNAL_SECTOR);
+  put_u32(header, JOURNAL_MAGIC);
+  put_u32(header + 4, log_start);
+  put_u32(header + 8, JOURNAL_SECTORS);
+  put_u32(header + 12, 1);
+
+  /* Build and write the directory tree. */
+  struct node root = {.is_dir = true, .sector = ROOT_DIR_SECTOR};
+  root.parent = &root;
+  for (; argi < argc; argi++) {
+    char* arg = argv[argi];
+    char* eq = strchr(arg, '=');
+    char* guest_name;
+    const char* host_name = arg;
+    if (eq != NULL) {
+      *eq = '\0';
+      guest_name = arg;
+      host_name = eq + 1;
+    } else {
+      const char* slash = strrchr(arg, '/');
+      guest_name = strdup(slash != NULL ? slash + 1 : arg);
+    }
+    add_file(&root, guest_name, host_name);
+  }
+  write_tree(&root);
+
+  /* The free map is written last, once every sector is allocated. */
+  const uint8_t* inode = sector_ptr(FREE_MAP_SECTOR);
+  for (size_t ofs = 0; ofs < free_map_size; ofs += SECTOR_SIZE) {
+    const uint8_t* p = inode + 8 + 4 * (ofs / SECTOR_SIZE);
+    uint32_t block = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    size_t chunk = free_map_size - ofs < SECTOR_SIZE ? free_map_size - ofs : SECTOR_SIZE;
+    memcpy(sector_ptr(block), free_map + ofs, chunk);
+  }
+
+  FILE* f = fopen(image_name, "wb");
+  if (f == NULL)
+    fail("%s: create: %s", image_name, strerror(errno));
+  if (fwrite(image, SECTOR_SIZE, sector_cnt, f) != sector_cnt || fclose(f) != 0)
+    fail("%s: write: %s", image_name, strerror(errno));
+  return EXIT_SUCCESS;
+}